@@ -0,0 +1,555 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "list.h"
+
+/*
+	micro-benchmarks for the list operations that have dedicated fast paths.
+	usage: ./bench [element count] (defaults to 1000000)
+*/
+
+double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+void announce_bench(const char * bench_name, const int count) {
+	printf("\nbenchmark '%s' (%d elements)\n", bench_name, count);
+}
+
+void report(const char * label, const double seconds) {
+	printf("  %-32s %10.3f ms\n", label, (seconds * 1000));
+}
+
+/* random lowercase keys of 8 to 16 characters, seeded so every run sees the same data */
+StringList* random_keys(const int count, const unsigned int seed) {
+	StringList* list = listNewCapacity(count);
+	char buffer[17];
+
+	srand(seed);
+	for (int i = 0; i < count; i++) {
+		int length = 8 + (rand() % 9);
+		for (int c = 0; c < length; c++) {
+			buffer[c] = 'a' + (rand() % 26);
+		}
+		buffer[length] = '\0';
+		listAdd(list, buffer);
+	}
+
+	return list;
+}
+
+int compare_strings(const char * a, const char * b) {
+	return strcmp(a, b);
+}
+
+int compare_qsort(const void * a, const void * b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+void bench_sort(const int count) {
+	announce_bench("sort", count);
+
+	StringList* keys = random_keys(count, 1);
+
+	StringList* list = listSublist(keys, 0, count);
+	double start = now_seconds();
+	qsort(list->list, list->length, sizeof(char *), &compare_qsort);
+	report("qsort + strcmp", now_seconds() - start);
+	listDestroy(list);
+
+	list = listSublist(keys, 0, count);
+	start = now_seconds();
+	listSort(list, &compare_strings);
+	report("listSort (merge sort)", now_seconds() - start);
+	listDestroy(list);
+
+	list = listSublist(keys, 0, count);
+	start = now_seconds();
+	listSortLexicographic(list);
+	report("listSortLexicographic", now_seconds() - start);
+	listDestroy(list);
+
+	listDestroy(keys);
+}
+
+void bench_sort_parallel(const int count) {
+	announce_bench("sort_parallel", count);
+
+	StringList* keys = random_keys(count, 1);
+	int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	int thread_counts[] = { 1, 2, 4, 8, cores };
+
+	StringList* list = listSublist(keys, 0, count);
+	double start = now_seconds();
+	listSort(list, &compare_strings);
+	report("listSort", now_seconds() - start);
+	listDestroy(list);
+
+	for (int t = 0; t < 5; t++) {
+		char label[64];
+		snprintf(label, sizeof(label), "listSortParallel (%d threads)", thread_counts[t]);
+
+		list = listSublist(keys, 0, count);
+		start = now_seconds();
+		listSortParallel(list, &compare_strings, thread_counts[t]);
+		report(label, now_seconds() - start);
+		listDestroy(list);
+	}
+
+	listDestroy(keys);
+}
+
+void bench_index_of(const int count) {
+	announce_bench("index_of (missing key, 10 scans)", count);
+
+	StringList* plain = random_keys(count, 2);
+	StringList* tagged = listClone(plain);
+	listEnableMetadata(tagged);
+
+	double start = now_seconds();
+	int found = 0;
+	for (int r = 0; r < 10; r++) {
+		found += (listIndexOf(plain, "not-a-key") != -1);
+	}
+	report("strcmp scan", now_seconds() - start);
+
+	start = now_seconds();
+	for (int r = 0; r < 10; r++) {
+		found += (listIndexOf(tagged, "not-a-key") != -1);
+	}
+	char label[64];
+	snprintf(label, sizeof(label), "metadata scan (%s kernel)", listSearchKernel());
+	report(label, now_seconds() - start);
+
+	if (found != 0) {
+		printf("  unexpected match\n");
+	}
+
+	listDestroy(plain);
+	listDestroy(tagged);
+}
+
+/* drops roughly half of the random keys */
+bool starts_early(const char * element) {
+	return (element[0] < 'n');
+}
+
+void bench_parallel_scans(const int count) {
+	announce_bench("parallel_scans", count);
+
+	StringList* keys = random_keys(count, 3);
+	int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	int thread_counts[] = { 1, cores };
+
+	for (int t = 0; t < 2; t++) {
+		char label[64];
+		int threads = thread_counts[t];
+
+		double start = now_seconds();
+		listParallelIndexOf(keys, "not-a-key", threads);
+		snprintf(label, sizeof(label), "listParallelIndexOf (%d threads)", threads);
+		report(label, now_seconds() - start);
+
+		start = now_seconds();
+		listParallelCount(keys, &starts_early, threads);
+		snprintf(label, sizeof(label), "listParallelCount (%d threads)", threads);
+		report(label, now_seconds() - start);
+
+		StringList* list = listSublist(keys, 0, count);
+		start = now_seconds();
+		listParallelRemoveIf(list, &starts_early, threads);
+		snprintf(label, sizeof(label), "listParallelRemoveIf (%d threads)", threads);
+		report(label, now_seconds() - start);
+		listDestroy(list);
+	}
+
+	listDestroy(keys);
+}
+
+void bench_queue(const int count) {
+	announce_bench("queue (add all, then remove from the front)", count);
+
+	StringList* keys = random_keys(count, 4);
+	StringList* list = listNew();
+
+	double start = now_seconds();
+	for (int i = 0; i < count; i++) {
+		listAdd(list, listGet(keys, i));
+	}
+	while (!listIsEmpty(list)) {
+		listRemove(list, 0);
+	}
+	report("listAdd + listRemove(0)", now_seconds() - start);
+
+	listDestroy(list);
+	listDestroy(keys);
+}
+
+void bench_clone(const int count) {
+	announce_bench("clone", count);
+
+	StringList* keys = random_keys(count, 6);
+
+	double start = now_seconds();
+	StringList* copy = listSublist(keys, 0, count);
+	report("listSublist (deep copy)", now_seconds() - start);
+
+	start = now_seconds();
+	StringList* clone = listClone(keys);
+	report("listClone (shared)", now_seconds() - start);
+
+	start = now_seconds();
+	listSet(clone, 0, "first write");
+	report("first write to the clone", now_seconds() - start);
+
+	listDestroy(copy);
+	listDestroy(clone);
+	listDestroy(keys);
+}
+
+void bench_insert_middle(const int count) {
+	announce_bench("random inserts then removals on a list of 'count' elements", count);
+
+	StringList* keys = random_keys(count, 5);
+	int operations = 20000;
+
+	StringList* flat = listSublist(keys, 0, count);
+	srand(5);
+	double start = now_seconds();
+	for (int i = 0; i < operations; i++) {
+		listInsert(flat, (rand() % listLength(flat)), listGet(keys, i));
+	}
+	for (int i = 0; i < operations; i++) {
+		listRemove(flat, (rand() % listLength(flat)));
+	}
+	report("listInsert + listRemove", now_seconds() - start);
+
+	TieredStringList* tiered = tieredListFromList(keys);
+	srand(5);
+	start = now_seconds();
+	for (int i = 0; i < operations; i++) {
+		tieredListInsert(tiered, (rand() % tieredListLength(tiered)), listGet(keys, i));
+	}
+	for (int i = 0; i < operations; i++) {
+		tieredListRemove(tiered, (rand() % tieredListLength(tiered)));
+	}
+	report("tieredListInsert + tieredListRemove", now_seconds() - start);
+
+	listDestroy(flat);
+	tieredListDestroy(tiered);
+	listDestroy(keys);
+}
+
+#define MIXED_OPERATIONS 200000 // split across the threads, 1 in 20 a write
+#define MIXED_ELEMENTS 10000
+
+typedef struct {
+	const StringList *keys;
+	StringList *locked; // guarded by 'lock' when not NULL
+	pthread_mutex_t *lock;
+	ConcurrentStringList *concurrent;
+	int operations;
+	unsigned int seed;
+} mixed_worker;
+
+void *run_mixed(void *arg) {
+	mixed_worker *worker = arg;
+	int elements = listLength(worker->keys);
+
+	for (int i = 0; i < worker->operations; i++) {
+		int r = rand_r(&worker->seed);
+		const char *key = listGet(worker->keys, (r % elements));
+		bool write = ((r % 20) == 0);
+
+		if (worker->locked != NULL) {
+			pthread_mutex_lock(worker->lock);
+			if (write) {
+				listSet(worker->locked, (r % elements), key);
+			} else {
+				listContains(worker->locked, key);
+			}
+			pthread_mutex_unlock(worker->lock);
+		} else if (write) {
+			concurrentListSet(worker->concurrent, (r % elements), key);
+		} else {
+			concurrentListContains(worker->concurrent, key);
+		}
+	}
+	return NULL;
+}
+
+double time_mixed(mixed_worker *prototype, const int threads) {
+	pthread_t ids[threads];
+	mixed_worker workers[threads];
+
+	double start = now_seconds();
+	for (int t = 0; t < threads; t++) {
+		workers[t] = *prototype;
+		workers[t].operations = (MIXED_OPERATIONS / threads);
+		workers[t].seed = (t + 1);
+		pthread_create(&ids[t], NULL, &run_mixed, &workers[t]);
+	}
+	for (int t = 0; t < threads; t++) {
+		pthread_join(ids[t], NULL);
+	}
+	return now_seconds() - start;
+}
+
+/* a fixed-size list read by several threads with 5% writes, behind one mutex and as a ConcurrentStringList */
+void bench_concurrent(const int count) {
+	int elements = (count < MIXED_ELEMENTS) ? count : MIXED_ELEMENTS;
+	announce_bench("95/5 read/write mix from several threads", elements);
+
+	StringList* keys = random_keys(elements, 7);
+	int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	int thread_counts[] = { 1, 2, 4, cores };
+
+	for (int t = 0; t < 4; t++) {
+		char label[64];
+		int threads = thread_counts[t];
+
+		pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+		mixed_worker worker = { keys, listEnableMetadata(listSublist(keys, 0, elements)), &lock, NULL, 0, 0 };
+		double seconds = time_mixed(&worker, threads);
+		snprintf(label, sizeof(label), "global mutex (%d threads)", threads);
+		report(label, seconds);
+		listDestroy(worker.locked);
+
+		worker.locked = NULL;
+		worker.concurrent = concurrentListFromList(keys);
+		seconds = time_mixed(&worker, threads);
+		snprintf(label, sizeof(label), "ConcurrentStringList (%d threads)", threads);
+		report(label, seconds);
+		concurrentListDestroy(worker.concurrent);
+	}
+
+	listDestroy(keys);
+}
+
+typedef struct {
+	const StringList *keys;
+	StringList *locked; // guarded by 'lock' when not NULL
+	pthread_mutex_t *lock;
+	AppendStringList *append;
+	int from;
+	int to;
+} append_worker;
+
+void *run_appends(void *arg) {
+	append_worker *worker = arg;
+	for (int i = worker->from; i < worker->to; i++) {
+		if (worker->locked != NULL) {
+			pthread_mutex_lock(worker->lock);
+			listAdd(worker->locked, listGet(worker->keys, i));
+			pthread_mutex_unlock(worker->lock);
+		} else {
+			appendListAdd(worker->append, listGet(worker->keys, i));
+		}
+	}
+	return NULL;
+}
+
+double time_appends(append_worker *prototype, const int threads) {
+	pthread_t ids[threads];
+	append_worker workers[threads];
+	int count = listLength(prototype->keys);
+
+	double start = now_seconds();
+	for (int t = 0; t < threads; t++) {
+		workers[t] = *prototype;
+		workers[t].from = (int) (((long) count * t) / threads);
+		workers[t].to = (int) (((long) count * (t + 1)) / threads);
+		pthread_create(&ids[t], NULL, &run_appends, &workers[t]);
+	}
+	for (int t = 0; t < threads; t++) {
+		pthread_join(ids[t], NULL);
+	}
+	return now_seconds() - start;
+}
+
+/* many producers appending to one list, behind one mutex and as an AppendStringList */
+void bench_append(const int count) {
+	announce_bench("appends from several producer threads", count);
+
+	StringList* keys = random_keys(count, 8);
+	int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	int thread_counts[] = { 1, 4, 16, cores };
+
+	for (int t = 0; t < 4; t++) {
+		char label[64];
+		int threads = thread_counts[t];
+
+		pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+		append_worker worker = { keys, listNew(), &lock, NULL, 0, 0 };
+		double seconds = time_appends(&worker, threads);
+		snprintf(label, sizeof(label), "mutex + listAdd (%d threads)", threads);
+		report(label, seconds);
+		listDestroy(worker.locked);
+
+		worker.locked = NULL;
+		worker.append = appendListNew();
+		seconds = time_appends(&worker, threads);
+		snprintf(label, sizeof(label), "appendListAdd (%d threads)", threads);
+		report(label, seconds);
+		appendListDestroy(worker.append);
+	}
+
+	listDestroy(keys);
+}
+
+/* startup cost of a saved reference list: rebuilding it with listAdd against mapping the saved file */
+void bench_load(const int count) {
+	announce_bench("load a saved list", count);
+
+	const char *path = "bench_load.bin";
+	StringList* keys = random_keys(count, 9);
+	if (!listSave(keys, path)) {
+		printf("  could not write '%s'\n", path);
+		listDestroy(keys);
+		return;
+	}
+
+	double start = now_seconds();
+	StringList* rebuilt = listNewCapacity(count);
+	for (int i = 0; i < count; i++) {
+		listAdd(rebuilt, listGet(keys, i));
+	}
+	report("listAdd each element", now_seconds() - start);
+
+	start = now_seconds();
+	StringList* mapped = listOpenMapped(path);
+	report("listOpenMapped", now_seconds() - start);
+
+	start = now_seconds();
+	listIndexOf(mapped, "not-a-key");
+	report("first listIndexOf on the mapping", now_seconds() - start);
+
+	listDestroy(mapped);
+	listDestroy(rebuilt);
+	listDestroy(keys);
+	remove(path);
+}
+
+/* populating a list from a text file with one element per line */
+void bench_load_lines(const int count) {
+	announce_bench("load a newline-delimited file", count);
+
+	const char *path = "bench_load_lines.txt";
+	StringList* keys = random_keys(count, 10);
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("  could not write '%s'\n", path);
+		listDestroy(keys);
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		fprintf(file, "%s\n", listGet(keys, i));
+	}
+	fclose(file);
+
+	double start = now_seconds();
+	StringList* added = listNew();
+	file = fopen(path, "rb");
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t read;
+	while ((read = getline(&line, &line_size, file)) != -1) {
+		line[read - 1] = '\0';
+		listAdd(added, line);
+	}
+	fclose(file);
+	free(line);
+	report("getline + listAdd", now_seconds() - start);
+
+	start = now_seconds();
+	StringList* loaded = listLoadLines(path, '\n');
+	report("listLoadLines", now_seconds() - start);
+
+	listDestroy(loaded);
+	listDestroy(added);
+	listDestroy(keys);
+	remove(path);
+}
+
+#define STRCAT_ELEMENTS 20000 // repeated strcat is quadratic, so only a prefix is timed
+
+/* turning a list into one string or a stream; run with 10000000 elements to see the large-list case */
+void bench_join(const int count) {
+	announce_bench("join and write", count);
+
+	StringList* keys = random_keys(count, 11);
+	int prefix = (count < STRCAT_ELEMENTS) ? count : STRCAT_ELEMENTS;
+	char label[64];
+
+	double start = now_seconds();
+	char *joined = calloc(((size_t) prefix * 18) + 1, 1);
+	for (int i = 0; i < prefix; i++) {
+		strcat(joined, listGet(keys, i));
+		strcat(joined, ",");
+	}
+	snprintf(label, sizeof(label), "strcat (first %d only)", prefix);
+	report(label, now_seconds() - start);
+	free(joined);
+
+	start = now_seconds();
+	joined = listJoin(keys, ",");
+	report("listJoin", now_seconds() - start);
+	free(joined);
+
+	FILE *sink = fopen("/dev/null", "wb");
+	if (sink == NULL) {
+		listDestroy(keys);
+		return;
+	}
+
+	start = now_seconds();
+	for (int i = 0; i < count; i++) {
+		fprintf(sink, "%s\n", listGet(keys, i));
+	}
+	fflush(sink);
+	report("fprintf per element", now_seconds() - start);
+
+	start = now_seconds();
+	listWrite(keys, sink, "\n");
+	fflush(sink);
+	report("listWrite", now_seconds() - start);
+
+	fclose(sink);
+	listDestroy(keys);
+}
+
+int main(int argc, char **argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+	// add benchmarks here and they will be run in order
+	void (*benches[])(const int) = {
+		&bench_sort,
+		&bench_sort_parallel,
+		&bench_index_of,
+		&bench_parallel_scans,
+		&bench_queue,
+		&bench_insert_middle,
+		&bench_clone,
+		&bench_concurrent,
+		&bench_append,
+		&bench_load,
+		&bench_load_lines,
+		&bench_join,
+	};
+
+	int bench_count = sizeof(benches) / sizeof(void (*)(const int));
+	for (int i = 0; i < bench_count; i++) {
+		benches[i](count);
+	}
+
+	return 0;
+}
@@ -1,344 +1,4910 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(LIST_NO_SIMD)
+#include <immintrin.h>
+#define LIST_X86_SIMD
+#endif
 
 #include "list.h"
 
+#if defined(__GLIBC__)
+#include <malloc.h> // malloc_usable_size, for the allocator overhead in listStats
+#endif
+
+/*
+	operation counters: build with -DLIST_STATS to count compares, slot shifts and allocations
+	in each list's 'counters'. otherwise the counting compiles away and those counters stay 0.
+	increments are relaxed atomics because parallel scans count from several threads.
+*/
+#ifdef LIST_STATS
+#define _LIST_COUNT(sl, counter, n) __atomic_fetch_add(&((StringList *) (sl))->counters.counter, (n), __ATOMIC_RELAXED)
+#else
+#define _LIST_COUNT(sl, counter, n) ((void) 0)
+#endif
+
+
 /**
-	TODO:
-	char *list_to_string(const StringList *sl);
-	void list_sort(const StringList *sl, int (*comparator_funct)(const char *, const char *))); // quicksort
+	tracing: hooks are kept in a small fixed table that is only appended to, so callers read it
+	without a lock. in builds with -DLIST_TRACE every public function opens a trace scope that
+	times it with clock_gettime and reports to the hooks when it returns; a per-thread depth
+	keeps calls made by other list functions from being reported twice.
 **/
 
-StringList *listNewCapacity(const int capacity) {
+typedef struct {
+	ListTraceHook hook;
+	void *context;
+} _ListTraceEntry;
 
-	StringList *result = malloc(sizeof(StringList));
-	if (result == NULL) {
-		return NULL;
-	}
+_ListTraceEntry _list_trace_hooks[LIST_TRACE_HOOKS];
+atomic_int _list_trace_hook_count = 0;
+pthread_mutex_t _list_trace_lock = PTHREAD_MUTEX_INITIALIZER;
 
-	char **list = malloc(capacity * sizeof(char*));
-	if (list == NULL) {
-		free(result);
-		return NULL;
+// register 'hook' to be called with 'context' after each traced call, false once LIST_TRACE_HOOKS are in use
+bool listAddTraceHook(ListTraceHook hook, void *context) {
+	pthread_mutex_lock(&_list_trace_lock);
+	int count = atomic_load(&_list_trace_hook_count);
+	if (count == LIST_TRACE_HOOKS) {
+		pthread_mutex_unlock(&_list_trace_lock);
+		return false;
 	}
 
-	result->list = list;
-	result->length = 0;
-	result->capacity = capacity;
+	_list_trace_hooks[count].hook = hook;
+	_list_trace_hooks[count].context = context;
+	atomic_store_explicit(&_list_trace_hook_count, (count + 1), memory_order_release); // publish the filled entry
+	pthread_mutex_unlock(&_list_trace_lock);
+	return true;
+}
 
-	return result;
+// stop calling every hook, callers must make sure no traced call is still running one
+void listClearTraceHooks() {
+	pthread_mutex_lock(&_list_trace_lock);
+	atomic_store(&_list_trace_hook_count, 0);
+	pthread_mutex_unlock(&_list_trace_lock);
 }
 
-StringList *listNew() {
-	return listNewCapacity(10);
+#define LIST_OP_NAME(name) #name,
+const char *_list_operation_names[] = { LIST_OPERATIONS(LIST_OP_NAME) };
+
+const char *listOperationName(const ListOperation operation) {
+	assert(operation >= 0);
+	assert(operation < LIST_OP_COUNT);
+
+	return _list_operation_names[operation];
 }
 
-StringList *listSublist(const StringList *sl, const int from, const int to) {
-	assert(from >= 0); // make sure the 'from' index is not negative
-	assert(to <= sl->length); // make sure 'to' is an existing index in 'list'
-	assert(to > from);
+#ifdef LIST_TRACE
 
-	// initialize a new StringList with initial capacity exactly the finished size
-	StringList *result = listNewCapacity((to - from));
+typedef struct {
+	ListOperation operation;
+	const void *list;
+	int count;
+	bool outermost;
+	struct timespec start;
+} _ListTraceScope;
 
-	for (int i = from; i < to; i++) { // for each index in [to, from)
-		// add this element from the master list to the sublist
-		if (listAdd(result, sl->list[i]) == NULL) {
-			listDestroy(result);
-			return NULL;
-		}
-	}
+_Thread_local int _list_trace_depth = 0;
 
-	return result;
+_ListTraceScope _list_trace_begin(const ListOperation operation, const void *list, const int count) {
+	_ListTraceScope scope = { operation, list, count, (_list_trace_depth++ == 0), { 0, 0 } };
+	if (scope.outermost) {
+		clock_gettime(CLOCK_MONOTONIC, &scope.start);
+	}
+	return scope;
 }
 
-// return a sublist clone containing the entire original list
-StringList *listClone(const StringList *sl) {
-	return listSublist(sl, 0, sl->length);
-}
+void _list_trace_end(_ListTraceScope *scope) {
+	_list_trace_depth--;
+	if (!scope->outermost) {
+		return;
+	}
 
-void listDestroy(StringList *sl) {
-	for (int i = 0; i < sl->length; i++) {
-		free(sl->list[i]); // free each string buffer
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	uint64_t nanoseconds = ((uint64_t) (end.tv_sec - scope->start.tv_sec) * 1000000000u) + end.tv_nsec - scope->start.tv_nsec;
+
+	int count = atomic_load_explicit(&_list_trace_hook_count, memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		_list_trace_hooks[i].hook(scope->operation, scope->list, scope->count, nanoseconds, _list_trace_hooks[i].context);
 	}
-	free(sl->list); // free string buffer array
-	free(sl); // free struct memory
 }
 
+// time the rest of the enclosing function, reporting on every return path
+#define _LIST_TRACE(name, list, count) \
+	_ListTraceScope _list_trace_scope __attribute__((cleanup(_list_trace_end))) = _list_trace_begin(LIST_OP_##name, (list), (count))
 
-// beware: providing a capacity less than the current List's length will drop the overflow elements
-StringList *listSetCapacity(StringList *sl, const int capacity) {
+#else
+#define _LIST_TRACE(name, list, count)
+#endif
 
-	if (capacity < sl->length) { // if the new capacity is less than the current length
-		// new capacity is the first index to be dropped, continue to the end of the current internal list
-		for (int i = capacity; i < sl->length; i++) {
-			// free the element's buffer to prevent leak
-			free(sl->list[i]);
-		}
-		sl->length = capacity; // update the length field
-	}
+/**
+	allocators: every block a list owns or uses along the way comes from its ListAllocator,
+	which is copied into the list (and into its arena, cells and index) when it is created.
+	lists that were not given one use malloc, realloc and free.
+**/
 
-	// resize the memory allocated to this StringList's internal list
-	char **newList = realloc(sl->list, (capacity * sizeof(char*)));
-	if (newList == NULL) {
-		return NULL;
-	}
+void *_list_std_alloc(void *context, size_t size) {
+	return malloc(size);
+}
 
-	sl->list = newList;
-	sl->capacity = capacity;
-	return sl;
+void *_list_std_realloc(void *context, void *block, size_t size) {
+	return realloc(block, size);
 }
 
-StringList *listEnsureCapacity(StringList *sl, const int capacity) {
-	if (capacity > sl->capacity) {
-		return listSetCapacity(sl, capacity);
-	} else {
-		return sl;
+void _list_std_free(void *context, void *block) {
+	free(block);
+}
+
+const ListAllocator _list_std_allocator = { &_list_std_alloc, &_list_std_realloc, &_list_std_free, NULL };
+
+void *_list_alloc(const ListAllocator *allocator, const size_t size) {
+	return allocator->alloc_funct(allocator->context, size);
+}
+
+void *_list_realloc(const ListAllocator *allocator, void *block, const size_t size) {
+	if (block == NULL) { // custom realloc functions need not accept NULL either
+		return allocator->alloc_funct(allocator->context, size);
 	}
+	return allocator->realloc_funct(allocator->context, block, size);
 }
 
-StringList *listTrimCapacity(StringList *sl) {
-	return listSetCapacity(sl, sl->length);
+void _list_free(const ListAllocator *allocator, void *block) {
+	if (block != NULL) { // custom free functions need not accept NULL
+		allocator->free_funct(allocator->context, block);
+	}
 }
 
-StringList *_list_expand_auto(StringList *sl) {
-	return listSetCapacity(sl, ((sl->capacity * 2) + 1)); // 2x current capacity plus 1
+// whether blocks from 'a' can be released through 'b'
+bool _list_same_allocator(const ListAllocator *a, const ListAllocator *b) {
+	return (a->alloc_funct == b->alloc_funct) && (a->realloc_funct == b->realloc_funct) &&
+		(a->free_funct == b->free_funct) && (a->context == b->context);
 }
 
 
-StringList *_list_set_unchecked(StringList *sl, const int index, const char *value) {
+/**
+	arena storage: element copies are bump-allocated out of large chunks owned by the list
+	instead of one malloc() per element. chunks are only returned on destroy, clear or an
+	explicit listCompactArena(), so overwrites and removals leave holes until then.
+**/
 
-	char *copyBuf = malloc(strlen(value) + 1); // create a buffer for a copy of the 'value' string
-	if (copyBuf == NULL) {
+typedef struct _ListArenaChunk {
+	struct _ListArenaChunk *next;
+	size_t size; // usable bytes in 'data'
+	size_t used; // bytes handed out so far
+	char data[];
+} ListArenaChunk;
+
+struct _ListArena {
+	ListAllocator allocator;
+	ListArenaChunk *chunks; // the first chunk is the one currently being filled
+	size_t chunk_size;
+	size_t wasted; // bytes held by overwritten or removed elements
+};
+
+ListArenaChunk *_list_arena_chunk_new(const ListArena *arena, const size_t size) {
+	ListArenaChunk *chunk = _list_alloc(&arena->allocator, (sizeof(ListArenaChunk) + size));
+	if (chunk == NULL) {
 		return NULL;
 	}
 
-	strcpy(copyBuf, value); // copy the 'value' string into the buffer
-	sl->list[index] = copyBuf; // set the pointer at the next index in the list to the new buffer
-	return sl;
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
 }
 
-StringList *listSet(StringList *sl, const int index, const char *value) {
-	// note: copies the 'value' string to make sure values are available until removed from the list
-	// printf("setting index '%d' (len = '%d')\n", index, list->length);
-	// lists can only be expanded one at a time by passing their current length as an index
-	assert(index <= sl->length);
-	assert(index >= 0);
-
-	// if this is a set() call for the n+1 element index (special case mentioned above)
-	if (index == sl->length) {
-		// if more capacity will be needed to store something at this index
-		if ((sl->length + 1) > sl->capacity) {
-			// expand the capacity to an automatically determined larger size
-		 	if (_list_expand_auto(sl) == NULL) {
-		 		return NULL;
-		 	}
-		}
-		sl->length++; // increase the length regardless, there is a new valid index
-	} else { // if this set() call will overwrite an existing element in the list
-		free(sl->list[index]); // free the memory at the pointer to be overwritten
+ListArena *_list_arena_new(const ListAllocator *allocator, const size_t chunk_size) {
+	ListArena *arena = _list_alloc(allocator, sizeof(ListArena));
+	if (arena == NULL) {
+		return NULL;
 	}
 
-	return _list_set_unchecked(sl, index, value);
+	arena->allocator = *allocator;
+	arena->chunks = NULL;
+	arena->chunk_size = chunk_size;
+	arena->wasted = 0;
+	return arena;
 }
 
-StringList *listAdd(StringList *sl, const char *value) {
-	return listSet(sl, sl->length, value);
-}
+char *_list_arena_alloc(ListArena *arena, const size_t size) {
+	ListArenaChunk *current = arena->chunks;
+	if ((current != NULL) && ((current->size - current->used) >= size)) {
+		char *result = &current->data[current->used];
+		current->used += size;
+		return result;
+	}
 
-StringList *listAddAll(StringList *sl, const StringList *src) {
-	for (int i = 0; i < src->length; i++) {
-		if (listAdd(sl, src->list[i]) == NULL) {
+	if (size > (arena->chunk_size / 2)) {
+		// oversized strings get a dedicated chunk so the current chunk keeps filling up
+		ListArenaChunk *chunk = _list_arena_chunk_new(arena, size);
+		if (chunk == NULL) {
 			return NULL;
 		}
+
+		chunk->used = size;
+		if (current == NULL) {
+			arena->chunks = chunk;
+		} else {
+			chunk->next = current->next;
+			current->next = chunk;
+		}
+		return chunk->data;
 	}
-	return sl;
+
+	ListArenaChunk *chunk = _list_arena_chunk_new(arena, arena->chunk_size);
+	if (chunk == NULL) {
+		return NULL;
+	}
+
+	chunk->used = size;
+	chunk->next = current;
+	arena->chunks = chunk;
+	return chunk->data;
 }
 
-StringList *listInsert(StringList *sl, const int index, const char *value) {
-	assert(index < sl->length);
-	assert(index >= 0);
+void _list_arena_free_chunks(ListArena *arena) {
+	ListArenaChunk *chunk = arena->chunks;
+	while (chunk != NULL) {
+		ListArenaChunk *next = chunk->next;
+		_list_free(&arena->allocator, chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	arena->wasted = 0;
+}
 
-	// make sure there's room for the added element
-	if ((sl->length + 1) > sl->capacity)  {
-		if (_list_expand_auto(sl) == NULL) { // expand the capacity
-			return NULL;
-		}
+void _list_arena_destroy(ListArena *arena) {
+	_list_arena_free_chunks(arena);
+	_list_free(&arena->allocator, arena);
+}
+
+
+/**
+	inline storage: strings shorter than LIST_INLINE_CELL bytes are copied into a contiguous
+	array of fixed-size cells owned by the list (one cell per unit of capacity), so slots
+	of short-string lists point into a single block instead of separate heap buffers.
+	longer strings fall back to their own heap buffer.
+**/
+
+struct _ListCells {
+	ListAllocator allocator;
+	char (*cells)[LIST_INLINE_CELL];
+	int count;
+	int *free_cells; // stack of unused cell indexes, the next cell to hand out is on top
+	int free_count;
+};
+
+// index of the cell 'value' points into, or -1 if it is not an inline string
+int _list_cell_index(const ListCells *cells, const char *value) {
+	uintptr_t base = (uintptr_t) cells->cells;
+	uintptr_t address = (uintptr_t) value;
+	if ((address < base) || (address >= (base + ((uintptr_t) cells->count * LIST_INLINE_CELL)))) {
+		return -1;
 	}
+	return (int) ((address - base) / LIST_INLINE_CELL);
+}
 
-	for (int i = (sl->length - 1); i >= index; i--) { // descend down the internal list
-		sl->list[(i + 1)] = sl->list[i]; // no copy needed, just move around the existing pointers
+ListCells *_list_cells_new(const ListAllocator *allocator, const int count) {
+	ListCells *cells = _list_alloc(allocator, sizeof(ListCells));
+	if (cells == NULL) {
+		return NULL;
 	}
 
-	// set the value at this index to a copy of the 'value' string
-	if (_list_set_unchecked(sl, index, value) == NULL) {
+	int allocated = (count > 0) ? count : 1;
+	cells->allocator = *allocator;
+	cells->cells = _list_alloc(allocator, (allocated * LIST_INLINE_CELL));
+	cells->free_cells = _list_alloc(allocator, (allocated * sizeof(int)));
+	if ((cells->cells == NULL) || (cells->free_cells == NULL)) {
+		_list_free(allocator, cells->cells);
+		_list_free(allocator, cells->free_cells);
+		_list_free(allocator, cells);
 		return NULL;
 	}
 
-	sl->length++; // increment the length, as one element has been added to the list
-	return sl;
+	cells->count = count;
+	cells->free_count = 0;
+	for (int i = (count - 1); i >= 0; i--) { // push in reverse so cells are handed out in address order
+		cells->free_cells[cells->free_count++] = i;
+	}
+	return cells;
 }
 
-StringList *listInsertAll(StringList *sl, const int index, const StringList *src) {
-	assert(index < sl->length);
-	assert(index >= 0);
+void _list_cells_destroy(ListCells *cells) {
+	ListAllocator allocator = cells->allocator;
+	_list_free(&allocator, cells->cells);
+	_list_free(&allocator, cells->free_cells);
+	_list_free(&allocator, cells);
+}
 
-	int destLen = sl->length;
-	int srcLen = src->length;
+// resize the cell block to 'count' cells, relocating any inline element that lives past the new end
+// note: the caller must have already dropped elements beyond 'count'
+ListCells *_list_cells_resize(StringList *sl, const int count) {
+	ListCells *old = sl->cells;
+	ListCells *fresh = _list_cells_new(&sl->allocator, count);
+	if (fresh == NULL) {
+		return NULL;
+	}
 
-	// make sure the destination has enough space for both sets of elements
-	if (listEnsureCapacity(sl, (destLen + srcLen)) == NULL) {
+	bool *used = _list_alloc(&sl->allocator, (((count > 0) ? count : 1) * sizeof(bool)));
+	if (used == NULL) {
+		_list_cells_destroy(fresh);
 		return NULL;
 	}
+	memset(used, 0, (((count > 0) ? count : 1) * sizeof(bool)));
+
+	// first pass: keep every inline element that still fits at the same cell index
+	for (int i = 0; i < sl->length; i++) {
+		int cell = _list_cell_index(old, sl->list[i]);
+		if ((cell >= 0) && (cell < count)) {
+			memcpy(fresh->cells[cell], old->cells[cell], LIST_INLINE_CELL);
+			sl->list[i] = fresh->cells[cell];
+			used[cell] = true;
+		}
+	}
 
-	// from the insert index to the end of the original list
-	for (int i = index; i < destLen; i++) {
-		sl->list[i + srcLen] = sl->list[i]; // move each string to the end of the new list
+	// rebuild the free stack from the untouched cells, lowest index on top
+	fresh->free_count = 0;
+	for (int c = (count - 1); c >= 0; c--) {
+		if (!used[c]) {
+			fresh->free_cells[fresh->free_count++] = c;
+		}
 	}
+	_list_free(&sl->allocator, used);
 
-	// copy-insert each string from src to dest
-	for (int o = 0; o < srcLen; o++) {
-		if (_list_set_unchecked(sl, (index + o), src->list[o]) == NULL) {
-			return NULL;
+	// second pass: move elements stranded past the end into free cells
+	for (int i = 0; i < sl->length; i++) {
+		int cell = _list_cell_index(old, sl->list[i]);
+		if (cell >= count) {
+			int target = fresh->free_cells[--fresh->free_count];
+			memcpy(fresh->cells[target], old->cells[cell], LIST_INLINE_CELL);
+			sl->list[i] = fresh->cells[target];
 		}
 	}
 
-	sl->length += srcLen;
-	return sl;
+	_list_cells_destroy(old);
+	sl->cells = fresh;
+	return fresh;
 }
 
 
-int listCapacity(const StringList *sl) {
-	return sl->capacity;
-}
+bool _list_borrow_own(StringList *sl, const char *value);
 
-int listLength(const StringList *sl) {
-	return sl->length;
+// allocate a buffer of 'size' bytes for an element from the list's storage
+char *_list_alloc_string(StringList *sl, const size_t size) {
+	_LIST_COUNT(sl, allocations, 1);
+	if ((sl->cells != NULL) && (size <= LIST_INLINE_CELL) && (sl->cells->free_count > 0)) {
+		return sl->cells->cells[sl->cells->free_cells[--sl->cells->free_count]];
+	}
+
+	char *buffer = (sl->arena != NULL) ? _list_arena_alloc(sl->arena, size) : _list_alloc(&sl->allocator, size);
+	if ((buffer != NULL) && (sl->borrowed != NULL) && !_list_borrow_own(sl, buffer)) {
+		if (sl->arena != NULL) {
+			sl->arena->wasted += size; // a hole until the next compaction
+		} else {
+			_list_free(&sl->allocator, buffer);
+		}
+		return NULL;
+	}
+	return buffer;
 }
 
-char *listGet(const StringList *sl, const int index) {
-	assert(index < sl->length); // make sure the index being retrieved actually exists
-	assert(index >= 0);
+bool _list_borrow_forget(StringList *sl, const char *value);
 
-	return sl->list[index];
+// give an element's buffer back to the list's storage
+void _list_release_string(StringList *sl, char *value) {
+	if (_list_borrow_forget(sl, value)) {
+		return; // it belongs to the storage it was borrowed from
+	}
+	int cell = (sl->cells != NULL) ? _list_cell_index(sl->cells, value) : -1;
+	if (cell >= 0) {
+		sl->cells->free_cells[sl->cells->free_count++] = cell; // the cell can be handed out again
+	} else if (sl->arena != NULL) {
+		sl->arena->wasted += (strlen(value) + 1); // leave a hole until the next compaction
+	} else {
+		_list_free(&sl->allocator, value);
+	}
 }
 
-int listIndexOf(const StringList *sl, const char *element) {
-	for (int i = 0; i < sl->length; i++) {
-		if (strcmp(sl->list[i], element) == 0) {
-			return i;
-		}
+
+/**
+	hash index: an optional open-addressing table from element string to its occurrence count
+	and first/last index. counts are kept exact on every mutation; positions are kept exact
+	for appends and overwrites, and are rebuilt by the mutation that shifted them, so lookups only
+	ever read the table. dropping elements from the front moves every position by the same amount,
+	which is recorded once in 'base' instead of rewriting each entry.
+**/
+
+typedef struct {
+	char *key; // copy of the element (or a borrowed pointer to it), NULL for an empty slot
+	uint32_t hash;
+	int count; // 0 with a non-NULL key marks a tombstone
+	int first;
+	int last;
+} ListIndexEntry;
+
+struct _ListIndex {
+	ListAllocator allocator;
+	ListIndexEntry *entries;
+	int slots; // always a power of two
+	int live; // keys with count > 0
+	int filled; // live keys plus tombstones
+	int base; // subtracted from the stored first/last to get the current positions
+	bool positions_valid;
+	bool owns_keys; // false for temporary sets that borrow the strings of a list that outlives them
+};
+
+// 32-bit FNV-1a, also reporting the length of 'value' through 'length' when it is not NULL
+uint32_t _list_hash_length(const char *value, size_t *length) {
+	uint32_t hash = 2166136261u;
+	const unsigned char *c = (const unsigned char *) value;
+	for (; *c != '\0'; c++) {
+		hash ^= *c;
+		hash *= 16777619u;
 	}
-	return -1;
+	if (length != NULL) {
+		*length = (size_t) (c - (const unsigned char *) value);
+	}
+	return hash;
 }
 
-int listLastIndexOf(const StringList *sl, const char *element) {
-	for (int i = (sl->length - 1); i >= 0; i--) {
-		if (strcmp(sl->list[i], element) == 0) {
-			return i;
-		}
-	}
-	return -1;
+uint32_t _list_hash(const char *value) {
+	return _list_hash_length(value, NULL);
 }
 
+ListIndex *_list_index_new(const ListAllocator *allocator, const int slots, const bool owns_keys) {
+	ListIndex *index = _list_alloc(allocator, sizeof(ListIndex));
+	if (index == NULL) {
+		return NULL;
+	}
+
+	index->allocator = *allocator;
+	index->entries = _list_alloc(allocator, (slots * sizeof(ListIndexEntry)));
+	if (index->entries == NULL) {
+		_list_free(allocator, index);
+		return NULL;
+	}
+	memset(index->entries, 0, (slots * sizeof(ListIndexEntry)));
 
-bool listIsEmpty(const StringList *sl) {
-	return (sl->length == 0);
+	index->slots = slots;
+	index->live = 0;
+	index->filled = 0;
+	index->base = 0;
+	index->positions_valid = true;
+	index->owns_keys = owns_keys;
+	return index;
 }
 
-bool listContains(const StringList *sl, const char *element) {
-	return (listIndexOf(sl, element) != -1); // index_of returns -1 if the element was not found
+void _list_index_destroy(ListIndex *index) {
+	ListAllocator allocator = index->allocator;
+	for (int i = 0; (i < index->slots) && index->owns_keys; i++) {
+		_list_free(&allocator, index->entries[i].key);
+	}
+	_list_free(&allocator, index->entries);
+	_list_free(&allocator, index);
 }
 
-bool listContainsAll(const StringList *sl, const StringList *must_contain) {
-	for (int i = 0; i < must_contain->length; i++) { // for each index in the must_contain List
-		// if the target list does not contain this element
-		if (!listContains(sl, must_contain->list[i])) {
-			return false; // the list does not "contain all"
+// find the entry for 'value', or the empty slot it would be inserted at
+ListIndexEntry *_list_index_probe(const ListIndex *index, const char *value, const uint32_t hash) {
+	ListIndexEntry *tombstone = NULL;
+	int mask = index->slots - 1;
+	for (int i = (int) (hash & mask); ; i = ((i + 1) & mask)) {
+		ListIndexEntry *entry = &index->entries[i];
+		if (entry->key == NULL) {
+			return (tombstone != NULL) ? tombstone : entry;
+		}
+		if ((entry->hash == hash) && (strcmp(entry->key, value) == 0)) {
+			return entry;
+		}
+		if ((entry->count == 0) && (tombstone == NULL)) {
+			tombstone = entry;
 		}
 	}
+}
 
-	// if no missing elements were found, 'list' contains all elements in 'must_contain'
-	return true;
+// returns the live entry for 'value', or NULL if the list holds no such element
+ListIndexEntry *_list_index_find(const ListIndex *index, const char *value) {
+	ListIndexEntry *entry = _list_index_probe(index, value, _list_hash(value));
+	return ((entry->key != NULL) && (entry->count > 0)) ? entry : NULL;
 }
 
-bool listEquals(const StringList *sl_a, const StringList *sl_b) {
-	if (sl_a->length != sl_b->length) { // the Lists cannot be equal if their lengths aren't equal
+// rehash every live key into a table of 'slots' entries, dropping tombstones
+bool _list_index_resize(ListIndex *index, const int slots) {
+	ListIndexEntry *entries = _list_alloc(&index->allocator, (slots * sizeof(ListIndexEntry)));
+	if (entries == NULL) {
 		return false;
 	}
+	memset(entries, 0, (slots * sizeof(ListIndexEntry)));
 
-	for (int i = 0; i < sl_a->length; i++) { // for each index in both Lists
-		// if the strings at this index in both Lists are not equal to each other
-		if (strcmp(sl_a->list[i], sl_b->list[i]) != 0) {
-			return false; // the Lists are not equal
+	for (int i = 0; i < index->slots; i++) {
+		ListIndexEntry *entry = &index->entries[i];
+		if (entry->key == NULL) {
+			continue;
+		}
+		if (entry->count == 0) {
+			if (index->owns_keys) {
+				_list_free(&index->allocator, entry->key); // tombstones do not survive a rehash
+			}
+			continue;
+		}
+
+		int mask = slots - 1;
+		int target = (int) (entry->hash & mask);
+		while (entries[target].key != NULL) {
+			target = ((target + 1) & mask);
 		}
+		entries[target] = *entry;
 	}
 
-	return true; // if no mismatches were found, the Lists are equal
+	_list_free(&index->allocator, index->entries);
+	index->entries = entries;
+	index->slots = slots;
+	index->filled = index->live;
+	return true;
 }
 
+// record that 'value' now occupies 'position'
+bool _list_index_add(ListIndex *index, const char *value, const int at) {
+	int position = (at + index->base);
+	if (((index->filled + 1) * 4) > (index->slots * 3)) { // keep the load factor under 3/4
+		int slots = index->slots;
+		while (((index->live + 1) * 2) > slots) {
+			slots *= 2;
+		}
+		if (!_list_index_resize(index, slots)) {
+			return false;
+		}
+	}
 
-void listRemove(StringList *sl, const int index) {
-	assert(index >= 0);
-	assert(index < sl->length); // make sure the index to be deleted actually exists
+	uint32_t hash = _list_hash(value);
+	ListIndexEntry *entry = _list_index_probe(index, value, hash);
 
-	free(sl->list[index]); // free the memory associated with this buffer before overwriting it
+	if ((entry->key != NULL) && (entry->count > 0)) { // another occurrence of a known element
+		entry->count++;
+		if (position < entry->first) {
+			entry->first = position;
+		}
+		if (position > entry->last) {
+			entry->last = position;
+		}
+		return true;
+	}
 
-	for (int i = index; i < (sl->length - 1); i++) {
-		sl->list[i] = sl->list[(i + 1)];
+	if (!index->owns_keys) {
+		if (entry->key == NULL) {
+			index->filled++;
+		}
+		entry->key = (char *) value;
+		entry->hash = hash;
+	} else if (entry->key == NULL) { // a fresh slot rather than a reused tombstone
+		entry->key = _list_alloc(&index->allocator, (strlen(value) + 1));
+		if (entry->key == NULL) {
+			return false;
+		}
+		strcpy(entry->key, value);
+		entry->hash = hash;
+		index->filled++;
+	} else { // reuse the tombstone, its old key may be shorter than the new one
+		char *key = _list_realloc(&index->allocator, entry->key, (strlen(value) + 1));
+		if (key == NULL) {
+			return false;
+		}
+		strcpy(key, value);
+		entry->key = key;
+		entry->hash = hash;
 	}
 
-	sl->length--;
+	entry->count = 1;
+	entry->first = position;
+	entry->last = position;
+	index->live++;
+	return true;
 }
 
-void listRemoveElement(StringList *sl, const char *element) {
-	int index = listIndexOf(sl, element);
-	if (index != -1) { // if the element exists
-		listRemove(sl, index);
-	}
-}
+// record that the occurrence of 'value' at 'position' is going away
+void _list_index_remove(ListIndex *index, const char *value, const int at) {
+	ListIndexEntry *entry = _list_index_find(index, value);
+	assert(entry != NULL);
 
-void listRemoveElements(StringList *sl, const char *element) {
-	int i = 0;
-	while (i < sl->length) {
-		if (strcmp(sl->list[i], element) == 0) {
-			listRemove(sl, i);
-		} else {
-			i++;
-		}
+	int position = (at + index->base);
+	entry->count--;
+	if (entry->count == 0) {
+		index->live--; // the slot stays as a tombstone so probe chains are not broken
+	} else if ((entry->first == position) || (entry->last == position)) {
+		index->positions_valid = false;
 	}
 }
 
-void listRemoveAll(StringList *sl, const StringList *to_remove) {
-	for (int i = 0; i < to_remove->length; i++) { // for each index in the to_remove List
-		listRemoveElements(sl, to_remove->list[i]);
+void _list_index_clear(ListIndex *index) {
+	for (int i = 0; (i < index->slots) && index->owns_keys; i++) {
+		_list_free(&index->allocator, index->entries[i].key);
 	}
+	memset(index->entries, 0, (index->slots * sizeof(ListIndexEntry)));
+	index->live = 0;
+	index->filled = 0;
+	index->base = 0;
+	index->positions_valid = true;
 }
 
-void listRemoveIf(StringList *sl, bool (*conditional_funct)(const char *)) {
-	int i = 0;
-	while (i < sl->length) {
-		if (conditional_funct(sl->list[i])) {
-			listRemove(sl, i);
-		} else {
-			i++;
+// recompute the first/last positions of every key after elements have been shifted
+void _list_index_refresh(StringList *sl) {
+	ListIndex *index = sl->index;
+	index->base = 0;
+	for (int i = 0; i < index->slots; i++) {
+		index->entries[i].first = -1;
+	}
+	for (int i = 0; i < sl->length; i++) {
+		ListIndexEntry *entry = _list_index_find(index, sl->list[i]);
+		if (entry->first == -1) {
+			entry->first = i;
 		}
+		entry->last = i;
 	}
+	index->positions_valid = true;
 }
 
-void listClear(StringList *sl) {
-	while (sl->length > 0) {
-		listRemove(sl, 0);
+// build an index over every element of 'sl'
+ListIndex *_list_index_build(const StringList *sl, const bool owns_keys) {
+	int slots = 16;
+	while ((slots * 3) < (sl->length * 4)) { // room for every element below the 3/4 load factor
+		slots *= 2;
 	}
-}
 
+	ListIndex *index = _list_index_new(&sl->allocator, slots, owns_keys);
+	if (index == NULL) {
+		return NULL;
+	}
 
-void listPrint(const StringList *sl) {
-	printf("list (%d/%d) elements: \n", sl->length, sl->capacity);
 	for (int i = 0; i < sl->length; i++) {
-		printf("element[%d] = '%s'\n", i, sl->list[i]);
+		if (!_list_index_add(index, sl->list[i], i)) {
+			_list_index_destroy(index);
+			return NULL;
+		}
 	}
+	return index;
+}
+
+// keep the index in step with the value that was just stored at 'index'
+void _list_index_stored(StringList *sl, const int index) {
+	if ((sl->index != NULL) && (sl->index->base > (INT_MAX - index))) {
+		_list_index_refresh(sl); // the stored position would overflow, start again from a zero base
+	}
+	if ((sl->index != NULL) && !_list_index_add(sl->index, sl->list[index], index)) {
+		listDisableIndex(sl); // an index that missed an element would give wrong answers
+	}
+}
+
+// note that elements have moved to different indexes
+void _list_index_shifted(StringList *sl) {
+	if (sl->index != NULL) {
+		sl->index->positions_valid = false;
+	}
+}
+
+// rebuild stale positions once the mutation that moved the elements has finished
+void _list_index_settle(StringList *sl) {
+	if ((sl->index != NULL) && !sl->index->positions_valid) {
+		_list_index_refresh(sl);
+	}
+}
+
+// release the element at 'index' without moving any other element
+void _list_drop_element(StringList *sl, const int index) {
+	if (sl->index != NULL) {
+		_list_index_remove(sl->index, sl->list[index], index);
+	}
+	_list_release_string(sl, sl->list[index]);
+}
+
+
+// table size for 'length' pointer keys, a power of two at most half full
+size_t _list_pointer_table_slots(const int length) {
+	size_t slots = 16;
+	while ((slots / 2) < (size_t) length) {
+		slots *= 2;
+	}
+	return slots;
+}
+
+// where the probe for 'key' starts in a table of 'slots' entries
+size_t _list_pointer_slot(const void *key, const size_t slots) {
+	return (size_t) ((((uint64_t) (uintptr_t) key) * 0x9E3779B97F4A7C15ull) >> 32) & (slots - 1);
+}
+
+
+/**
+	copy-on-write: listClone hands out a new StringList that shares the original's slot array,
+	strings, index and metadata, with a reference count in 'sl->share'. every list gets its
+	share record when it is created, so cloning only increments the count and never writes to
+	the source list. shared storage is read-only. the first modification through any holder
+	copies only that holder's slot and metadata arrays: its strings stay where they are,
+	borrowed from the shared storage, and the holder's reference to it moves to 'sl->borrowed'.
+	from then on the list records every heap or arena buffer it allocates in a set, so any
+	string not in the set (or in its inline cells) is borrowed. a borrowed string is never
+	freed or reused by the borrower, and once the last one has been overwritten or removed
+	the reference is dropped. the share record keeps a description of the storage for
+	whichever reference happens to be the last, so a write costs one pointer copy per element
+	and never copies a string. mapped lists are modified the same way, reading their strings
+	from the file until they are replaced.
+	a modification that runs out of memory while copying leaves the list unchanged.
+**/
+
+struct _ListShare {
+	ListAllocator allocator;
+	atomic_int refs; // lists using this storage or borrowing from it, 1 while it is not shared
+	_Atomic(StringList *) original; // the storage, recorded when its first holder moves off it
+};
+
+struct _ListBorrowed {
+	ListShare *from; // the storage the borrowed strings live in, kept by this reference
+	const char **own; // open-addressing set of the heap and arena buffers allocated since borrowing
+	size_t slots; // a power of two
+	int owned; // keys in 'own'
+	int live; // borrowed strings the list still holds
+};
+
+void _list_mapping_release(ListMapping *mapping);
+void _list_free_storage(StringList *sl);
+
+// drop one reference to 'share', freeing its storage when nothing uses it anymore
+// 'holder' is a list using the storage directly, NULL for a borrower
+void _list_share_drop(ListShare *share, StringList *holder) {
+	if (atomic_fetch_sub(&share->refs, 1) != 1) {
+		return;
+	}
+
+	ListAllocator allocator = share->allocator;
+	StringList *original = atomic_load(&share->original);
+	if (original != NULL) {
+		_list_free_storage(original); // the same storage as 'holder', if there is one
+		_list_free(&allocator, original);
+	} else {
+		assert(holder != NULL); // a borrower always records the storage first
+		_list_free_storage(holder);
+	}
+	_list_free(&allocator, share);
+}
+
+const char **_list_borrow_find(const ListBorrowed *borrowed, const char *value) {
+	size_t i = _list_pointer_slot(value, borrowed->slots);
+	while ((borrowed->own[i] != NULL) && (borrowed->own[i] != value)) {
+		i = (i + 1) & (borrowed->slots - 1);
+	}
+	return &borrowed->own[i];
+}
+
+// start borrowing the first 'count' elements of a list from 'from', NULL if memory ran out
+ListBorrowed *_list_borrow_new(const ListAllocator *allocator, const int count, ListShare *from) {
+	ListBorrowed *borrowed = _list_alloc(allocator, sizeof(ListBorrowed));
+	if (borrowed == NULL) {
+		return NULL;
+	}
+
+	borrowed->slots = _list_pointer_table_slots(0);
+	borrowed->own = _list_alloc(allocator, (borrowed->slots * sizeof(char *)));
+	if (borrowed->own == NULL) {
+		_list_free(allocator, borrowed);
+		return NULL;
+	}
+	memset(borrowed->own, 0, (borrowed->slots * sizeof(char *)));
+	borrowed->owned = 0;
+	borrowed->from = from;
+	borrowed->live = count;
+	return borrowed;
+}
+
+// record 'value' as a buffer of the list's own while it borrows, false if memory ran out
+bool _list_borrow_own(StringList *sl, const char *value) {
+	ListBorrowed *borrowed = sl->borrowed;
+	if (_list_pointer_table_slots(borrowed->owned + 1) > borrowed->slots) {
+		size_t slots = borrowed->slots * 2;
+		const char **own = _list_alloc(&sl->allocator, (slots * sizeof(char *)));
+		if (own == NULL) {
+			return false;
+		}
+		memset(own, 0, (slots * sizeof(char *)));
+
+		const char **old = borrowed->own;
+		size_t old_slots = borrowed->slots;
+		borrowed->own = own;
+		borrowed->slots = slots;
+		for (size_t i = 0; i < old_slots; i++) {
+			if (old[i] != NULL) {
+				*_list_borrow_find(borrowed, old[i]) = old[i];
+			}
+		}
+		_list_free(&sl->allocator, old);
+	}
+
+	const char **key = _list_borrow_find(borrowed, value);
+	if (*key == NULL) {
+		*key = value;
+		borrowed->owned++;
+	}
+	return true;
+}
+
+// remove the key at 'key' from the set, moving later keys of its probe chain back into the gap
+void _list_borrow_disown(ListBorrowed *borrowed, const char **key) {
+	size_t mask = borrowed->slots - 1;
+	size_t gap = (size_t) (key - borrowed->own);
+	size_t i = gap;
+	while (true) {
+		i = (i + 1) & mask;
+		if (borrowed->own[i] == NULL) {
+			break;
+		}
+		size_t home = _list_pointer_slot(borrowed->own[i], borrowed->slots);
+		if (((i - home) & mask) >= ((i - gap) & mask)) { // the gap lies on the probe path of this key
+			borrowed->own[gap] = borrowed->own[i];
+			gap = i;
+		}
+	}
+	borrowed->own[gap] = NULL;
+	borrowed->owned--;
+}
+
+// whether 'value' is a string 'sl' reads from another list's storage
+bool _list_is_borrowed(const StringList *sl, const char *value) {
+	if ((sl->borrowed == NULL) || ((sl->cells != NULL) && (_list_cell_index(sl->cells, value) >= 0))) {
+		return false;
+	}
+	return (*_list_borrow_find(sl->borrowed, value) == NULL);
+}
+
+// give up the borrowed strings, and the reference to the storage they live in
+void _list_borrow_end(StringList *sl) {
+	ListBorrowed *borrowed = sl->borrowed;
+	sl->borrowed = NULL;
+	_list_share_drop(borrowed->from, NULL);
+	_list_free(&sl->allocator, borrowed->own);
+	_list_free(&sl->allocator, borrowed);
+}
+
+// stop tracking 'value', which is leaving the list; true if it was borrowed and must not be released
+bool _list_borrow_forget(StringList *sl, const char *value) {
+	if ((sl->borrowed == NULL) || ((sl->cells != NULL) && (_list_cell_index(sl->cells, value) >= 0))) {
+		return false;
+	}
+
+	const char **key = _list_borrow_find(sl->borrowed, value);
+	if (*key != NULL) {
+		_list_borrow_disown(sl->borrowed, key);
+		return false;
+	}
+	if (--sl->borrowed->live == 0) {
+		_list_borrow_end(sl); // every borrowed string is gone, the storage can go too
+	}
+	return true;
+}
+
+// free everything 'sl' points to, but not the StringList itself
+void _list_free_storage(StringList *sl) {
+	if (sl->mapping != NULL) {
+		// the strings and metadata are pages of the mapped file, unmapped below
+	} else if (sl->arena != NULL) {
+		_list_arena_destroy(sl->arena); // every string buffer lives in the arena's chunks
+	} else {
+		for (int i = 0; i < sl->length; i++) {
+			_list_release_string(sl, sl->list[i]); // free each string buffer
+		}
+	}
+	if (sl->cells != NULL) {
+		_list_cells_destroy(sl->cells); // free every inline string at once
+	}
+	if (sl->index != NULL) {
+		_list_index_destroy(sl->index);
+	}
+	if ((sl->hashes != NULL) && (sl->mapping == NULL)) { // the metadata arrays start 'head' slots before element 0 too
+		_list_free(&sl->allocator, (sl->hashes - sl->head));
+		_list_free(&sl->allocator, (sl->lengths - sl->head));
+	}
+	_list_free(&sl->allocator, (sl->list - sl->head)); // free string buffer array
+	if (sl->mapping != NULL) {
+		_list_mapping_release(sl->mapping);
+	}
+	if (sl->borrowed != NULL) {
+		_list_borrow_end(sl); // arena and mapped lists don't release their strings one by one
+	}
+}
+
+// drop this list's reference to its storage, freeing the storage if it was the last one
+void _list_share_release(StringList *sl) {
+	_list_share_drop(sl->share, sl);
+	sl->share = NULL;
+}
+
+StringList *_list_new_like(const StringList *sl, const int capacity);
+bool _list_meta_resize(StringList *sl, const int capacity);
+
+/*
+	whether 'sl' is the only list left using its storage. the description of the storage recorded
+	while it was shared is dropped then, since 'sl' describes it again and may change it in place.
+	every modification that skips _list_unshare must check this instead of _list_is_shared.
+*/
+bool _list_sole_holder(StringList *sl) {
+	ListShare *share = sl->share;
+	if (atomic_load(&share->refs) != 1) {
+		return false;
+	}
+
+	StringList *original = atomic_load(&share->original);
+	if (original != NULL) { // no other reference is left to race for it
+		atomic_store(&share->original, NULL);
+		_list_free(&sl->allocator, original);
+	}
+	return true;
+}
+
+/*
+	give 'sl' slot and metadata arrays of its own before it is modified, keeping only its first
+	'keep' elements, whose strings it borrows. returns false if the copy could not be made.
+*/
+bool _list_unshare_keeping(StringList *sl, const int keep) {
+	ListShare *share = sl->share;
+	if ((sl->mapping == NULL) && _list_sole_holder(sl)) { // no other holder, or every other one is gone
+		return true;
+	}
+
+	StringList *copy = _list_new_like(sl, sl->capacity);
+	StringList *snapshot = _list_alloc(&sl->allocator, sizeof(StringList));
+	ListBorrowed *borrowed = (keep > 0) ? _list_borrow_new(&sl->allocator, keep, share) : NULL;
+	bool copied = (copy != NULL) && (snapshot != NULL) && ((keep == 0) || (borrowed != NULL));
+	if (copied) {
+		memcpy(copy->list, sl->list, (keep * sizeof(char*)));
+		copy->length = keep;
+		copy->sorted_by = sl->sorted_by;
+		copy->growth = sl->growth;
+		copy->max_step = sl->max_step;
+		copy->shrink_below = sl->shrink_below;
+		copy->reserved = sl->reserved;
+	}
+	if (copied && (sl->hashes != NULL)) {
+		copied = _list_meta_resize(copy, copy->capacity);
+		if (copied) {
+			memcpy(copy->hashes, sl->hashes, (keep * sizeof(uint32_t)));
+			memcpy(copy->lengths, sl->lengths, (keep * sizeof(uint32_t)));
+		}
+	}
+	if (copied && (sl->index != NULL)) {
+		copy->index = _list_index_build(copy, true);
+		copied = (copy->index != NULL);
+	}
+	if (!copied) {
+		if (copy != NULL) {
+			copy->length = 0; // its slots point at strings it never owned
+			listDestroy(copy);
+		}
+		if (borrowed != NULL) {
+			_list_free(&sl->allocator, borrowed->own);
+			_list_free(&sl->allocator, borrowed);
+		}
+		_list_free(&sl->allocator, snapshot);
+		return false;
+	}
+
+	// record the old storage with its share, unless another holder moving off it already has
+	*snapshot = *sl;
+	StringList *expected = NULL;
+	if (!atomic_compare_exchange_strong(&share->original, &expected, snapshot)) {
+		_list_free(&sl->allocator, snapshot);
+	}
+
+	ListCounters counters = sl->counters; // still the same list as far as the counters go
+	copy->borrowed = borrowed; // this list's reference to 'share' now belongs to the borrowed set
+	*sl = *copy;
+	sl->counters = counters;
+	_list_free(&sl->allocator, copy);
+	if (borrowed == NULL) {
+		_list_share_drop(share, NULL); // nothing was kept, so nothing is borrowed
+	}
+	return true;
+}
+
+bool _list_unshare(StringList *sl) {
+	return _list_unshare_keeping(sl, sl->length);
+}
+
+// whether some other list still reads the storage of 'sl'
+bool _list_is_shared(const StringList *sl) {
+	return (atomic_load(&sl->share->refs) > 1);
+}
+
+StringList *listEnableIndex(StringList *sl) {
+	_LIST_TRACE(listEnableIndex, sl, sl->length);
+	if (sl->index != NULL) {
+		return sl;
+	}
+	if (!_list_sole_holder(sl) && !_list_unshare(sl)) { // a mapped list can keep its pages, the index lives on the heap
+		return NULL;
+	}
+
+	ListIndex *index = _list_index_build(sl, true);
+	if (index == NULL) {
+		return NULL;
+	}
+
+	sl->index = index;
+	return sl;
+}
+
+void listDisableIndex(StringList *sl) {
+	_LIST_TRACE(listDisableIndex, sl, sl->length);
+	if ((sl->index != NULL) && (_list_sole_holder(sl) || _list_unshare(sl))) {
+		_list_index_destroy(sl->index);
+		sl->index = NULL;
+	}
+}
+
+/**
+	element metadata: optional packed arrays holding each element's length and 32-bit hash,
+	index-aligned with the slots and computed once when the element is stored. scans and
+	comparisons check the metadata first and only read string memory on a hash and length match.
+**/
+
+// lengths past this are clamped, comparisons then fall back to strcmp
+#define LIST_LENGTH_CLAMP UINT32_MAX
+
+// fill in the metadata of the element at 'index'
+void _list_meta_store(StringList *sl, const int index) {
+	if (sl->hashes != NULL) {
+		size_t length;
+		sl->hashes[index] = _list_hash_length(sl->list[index], &length);
+		sl->lengths[index] = (length < LIST_LENGTH_CLAMP) ? (uint32_t) length : LIST_LENGTH_CLAMP;
+	}
+}
+
+// recompute the metadata of every element, after the slots have been permuted
+void _list_meta_refresh(StringList *sl) {
+	for (int i = 0; (i < sl->length) && (sl->hashes != NULL); i++) {
+		_list_meta_store(sl, i);
+	}
+}
+
+/*
+	resize both metadata arrays to 'capacity' slots. if the second resize fails the first has
+	already happened, so on failure each array holds at least the smaller of its old and new
+	size: callers grow the metadata before raising 'sl->capacity' and shrink it only after.
+*/
+bool _list_meta_resize(StringList *sl, const int capacity) {
+	int allocated = (capacity > 0) ? capacity : 1;
+	uint32_t *hashes = _list_realloc(&sl->allocator, sl->hashes, (allocated * sizeof(uint32_t)));
+	if (hashes == NULL) {
+		return false;
+	}
+	sl->hashes = hashes;
+
+	uint32_t *lengths = _list_realloc(&sl->allocator, sl->lengths, (allocated * sizeof(uint32_t)));
+	if (lengths == NULL) {
+		return false;
+	}
+	sl->lengths = lengths;
+	return true;
+}
+
+// move 'count' slots (and their metadata) from 'src' to 'dst', the ranges may overlap
+void _list_move_slots(StringList *sl, const int dst, const int src, const int count) {
+	_LIST_COUNT(sl, shifts, count);
+	memmove(&sl->list[dst], &sl->list[src], (count * sizeof(char*)));
+	if (sl->hashes != NULL) {
+		memmove(&sl->hashes[dst], &sl->hashes[src], (count * sizeof(uint32_t)));
+		memmove(&sl->lengths[dst], &sl->lengths[src], (count * sizeof(uint32_t)));
+	}
+}
+
+/*
+	head offset: 'sl->list' points at element 0, which may sit 'sl->head' slots into the
+	allocation. removing from the front just advances the start, and inserting near the front
+	takes a slot from the head room, so both ends of the list are O(1) amortized.
+	'sl->capacity' always counts the whole allocation, head room included, so only the
+	slots left after the last element can take appends without moving anything.
+*/
+
+// free slots after the last element
+int _list_tail_room(const StringList *sl) {
+	return (sl->capacity - sl->head - sl->length);
+}
+
+// move the start of the list by 'delta' slots, positive values give slots to the head room
+void _list_advance_head(StringList *sl, const int delta) {
+	sl->list += delta;
+	if (sl->hashes != NULL) {
+		sl->hashes += delta;
+		sl->lengths += delta;
+	}
+	sl->head += delta;
+}
+
+// slide the elements back to the start of the allocation, indexes do not change
+void _list_linearize(StringList *sl) {
+	if (sl->head == 0) {
+		return;
+	}
+	int head = sl->head;
+	_list_advance_head(sl, -head);
+	_list_move_slots(sl, 0, head, sl->length);
+}
+
+// whether the element at 'index' equals 'element', whose hash and clamped length are given
+bool _list_element_equals(const StringList *sl, const int index, const char *element, const uint32_t hash, const uint32_t length) {
+	_LIST_COUNT(sl, compares, 1);
+	if (sl->hashes == NULL) {
+		return (strcmp(sl->list[index], element) == 0);
+	}
+	if ((sl->hashes[index] != hash) || (sl->lengths[index] != length)) {
+		return false; // rejected without touching the string
+	}
+	if (length == LIST_LENGTH_CLAMP) {
+		return (strcmp(sl->list[index], element) == 0);
+	}
+	return (memcmp(sl->list[index], element, length) == 0);
+}
+
+// hash and clamped length of a probe string, computed only when 'sl' keeps metadata
+void _list_probe(const StringList *sl, const char *element, uint32_t *hash, uint32_t *length) {
+	*hash = 0;
+	*length = 0;
+	if (sl->hashes != NULL) {
+		size_t full;
+		*hash = _list_hash_length(element, &full);
+		*length = (full < LIST_LENGTH_CLAMP) ? (uint32_t) full : LIST_LENGTH_CLAMP;
+	}
+}
+
+/*
+	hash search kernels: find the first (or last) i in [from, to) with hashes[i] == hash.
+	on x86 the widest kernel the CPU supports is picked once at runtime (AVX2 compares 8
+	hashes per instruction, SSE2 4), everything else uses the portable loop. build with
+	-DLIST_NO_SIMD to force the portable loop.
+*/
+
+int _list_find_hash_portable(const uint32_t *hashes, const int from, const int to, const uint32_t hash, const bool reverse) {
+	if (reverse) {
+		for (int i = (to - 1); i >= from; i--) {
+			if (hashes[i] == hash) {
+				return i;
+			}
+		}
+	} else {
+		for (int i = from; i < to; i++) {
+			if (hashes[i] == hash) {
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+#ifdef LIST_X86_SIMD
+
+__attribute__((target("sse2")))
+int _list_find_hash_sse2(const uint32_t *hashes, const int from, const int to, const uint32_t hash, const bool reverse) {
+	__m128i needle = _mm_set1_epi32((int) hash);
+	if (reverse) {
+		int i = to;
+		for (; (i - 4) >= from; i -= 4) {
+			__m128i block = _mm_loadu_si128((const __m128i *) &hashes[(i - 4)]);
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+			if (mask != 0) {
+				return (i - 4) + (31 - __builtin_clz(mask));
+			}
+		}
+		return _list_find_hash_portable(hashes, from, i, hash, true);
+	}
+
+	int i = from;
+	for (; (i + 4) <= to; i += 4) {
+		__m128i block = _mm_loadu_si128((const __m128i *) &hashes[i]);
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return _list_find_hash_portable(hashes, i, to, hash, false);
+}
+
+__attribute__((target("avx2")))
+int _list_find_hash_avx2(const uint32_t *hashes, const int from, const int to, const uint32_t hash, const bool reverse) {
+	__m256i needle = _mm256_set1_epi32((int) hash);
+	if (reverse) {
+		int i = to;
+		for (; (i - 8) >= from; i -= 8) {
+			__m256i block = _mm256_loadu_si256((const __m256i *) &hashes[(i - 8)]);
+			int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+			if (mask != 0) {
+				return (i - 8) + (31 - __builtin_clz(mask));
+			}
+		}
+		return _list_find_hash_portable(hashes, from, i, hash, true);
+	}
+
+	int i = from;
+	for (; (i + 8) <= to; i += 8) {
+		__m256i block = _mm256_loadu_si256((const __m256i *) &hashes[i]);
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return _list_find_hash_portable(hashes, i, to, hash, false);
+}
+
+#endif
+
+typedef int (*_ListFindHash)(const uint32_t *, const int, const int, const uint32_t, const bool);
+
+_ListFindHash _list_find_hash = &_list_find_hash_portable;
+const char *_list_find_hash_name = "portable";
+pthread_once_t _list_find_hash_once = PTHREAD_ONCE_INIT;
+
+void _list_find_hash_select() {
+#ifdef LIST_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		_list_find_hash = &_list_find_hash_avx2;
+		_list_find_hash_name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		_list_find_hash = &_list_find_hash_sse2;
+		_list_find_hash_name = "sse2";
+	}
+#endif
+}
+
+_ListFindHash _list_find_hash_kernel() {
+	pthread_once(&_list_find_hash_once, &_list_find_hash_select);
+	return _list_find_hash;
+}
+
+// name of the hash search kernel in use: "avx2", "sse2" or "portable"
+const char *listSearchKernel() {
+	_LIST_TRACE(listSearchKernel, NULL, 0);
+	_list_find_hash_kernel();
+	return _list_find_hash_name;
+}
+
+// _list_scan for a list with metadata, given the probe's precomputed hash and clamped length
+int _list_scan_hashed(const StringList *sl, const int from, const int to, const char *element, const uint32_t hash, const uint32_t length, const bool reverse) {
+	_ListFindHash find = _list_find_hash_kernel();
+	int lo = from;
+	int hi = to;
+	while (lo < hi) {
+		int i = find(sl->hashes, lo, hi, hash, reverse);
+		if (i == -1) {
+			return -1;
+		}
+		if (_list_element_equals(sl, i, element, hash, length)) {
+			return i;
+		}
+		if (reverse) {
+			hi = i; // a hash collision, keep looking below it
+		} else {
+			lo = (i + 1);
+		}
+	}
+	return -1;
+}
+
+// index of the first (or with 'reverse', the last) occurrence of 'element' in [from, to), or -1
+int _list_scan(const StringList *sl, const int from, const int to, const char *element, const bool reverse) {
+	if (sl->hashes != NULL) {
+		// sweep the packed hash array, only matching hashes reach the full comparison
+		uint32_t hash;
+		uint32_t length;
+		_list_probe(sl, element, &hash, &length);
+		return _list_scan_hashed(sl, from, to, element, hash, length, reverse);
+	}
+
+	if (reverse) {
+		for (int i = (to - 1); i >= from; i--) {
+			_LIST_COUNT(sl, compares, 1);
+			if (strcmp(sl->list[i], element) == 0) {
+				return i;
+			}
+		}
+	} else {
+		for (int i = from; i < to; i++) {
+			_LIST_COUNT(sl, compares, 1);
+			if (strcmp(sl->list[i], element) == 0) {
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+StringList *listEnableMetadata(StringList *sl) {
+	_LIST_TRACE(listEnableMetadata, sl, sl->length);
+	if (sl->hashes != NULL) {
+		return sl;
+	}
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	_list_linearize(sl); // the metadata arrays share the slot array's head offset
+
+	if (!_list_meta_resize(sl, sl->capacity)) {
+		listDisableMetadata(sl);
+		return NULL;
+	}
+
+	_list_meta_refresh(sl);
+	return sl;
+}
+
+void listDisableMetadata(StringList *sl) {
+	_LIST_TRACE(listDisableMetadata, sl, sl->length);
+	if ((sl->hashes == NULL) || !_list_unshare(sl)) {
+		return;
+	}
+	_list_free(&sl->allocator, (sl->hashes - sl->head));
+	_list_free(&sl->allocator, (sl->lengths - sl->head));
+	sl->hashes = NULL;
+	sl->lengths = NULL;
+}
+
+// an empty list whose memory all comes from 'allocator', which is copied; NULL means malloc/realloc/free
+StringList *listNewWithAllocator(const int capacity, const ListAllocator *allocator) {
+	_LIST_TRACE(listNewWithAllocator, NULL, capacity);
+	if (allocator == NULL) {
+		allocator = &_list_std_allocator;
+	}
+
+	StringList *result = _list_alloc(allocator, sizeof(StringList));
+	if (result == NULL) {
+		return NULL;
+	}
+
+	char **list = _list_alloc(allocator, (((capacity > 0) ? capacity : 1) * sizeof(char*))); // never a zero-byte request
+	ListShare *share = _list_alloc(allocator, sizeof(ListShare));
+	if ((list == NULL) || (share == NULL)) {
+		_list_free(allocator, list);
+		_list_free(allocator, share);
+		_list_free(allocator, result);
+		return NULL;
+	}
+	share->allocator = *allocator;
+	atomic_init(&share->refs, 1);
+	atomic_init(&share->original, NULL);
+
+	result->allocator = *allocator;
+	result->list = list;
+	result->length = 0;
+	result->capacity = capacity;
+	result->head = 0;
+	result->arena = NULL;
+	result->cells = NULL;
+	result->mapping = NULL;
+	result->index = NULL;
+	result->sorted_by = NULL;
+	result->hashes = NULL;
+	result->lengths = NULL;
+	result->share = share;
+	result->borrowed = NULL;
+	result->growth = 2.0;
+	result->max_step = 0;
+	result->shrink_below = 0;
+	result->reserved = 0;
+	memset(&result->counters, 0, sizeof(ListCounters));
+
+	return result;
+}
+
+StringList *listNewCapacity(const int capacity) {
+	_LIST_TRACE(listNewCapacity, NULL, capacity);
+	return listNewWithAllocator(capacity, NULL);
+}
+
+// switch a new, empty list to arena storage, destroying it on failure
+StringList *_list_use_arena(StringList *result, const size_t arena_bytes) {
+	result->arena = _list_arena_new(&result->allocator, arena_bytes);
+	if (result->arena == NULL) {
+		listDestroy(result);
+		return NULL;
+	}
+	return result;
+}
+
+// switch a new, empty list to inline storage, destroying it on failure
+StringList *_list_use_cells(StringList *result) {
+	result->cells = _list_cells_new(&result->allocator, result->capacity);
+	if (result->cells == NULL) {
+		listDestroy(result);
+		return NULL;
+	}
+	return result;
+}
+
+StringList *listNewArena(const int capacity, const size_t arena_bytes) {
+	_LIST_TRACE(listNewArena, NULL, capacity);
+	assert(arena_bytes > 0);
+
+	StringList *result = listNewCapacity(capacity);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	return _list_use_arena(result, arena_bytes);
+}
+
+StringList *listNewInline(const int capacity) {
+	_LIST_TRACE(listNewInline, NULL, capacity);
+	StringList *result = listNewCapacity(capacity);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	return _list_use_cells(result);
+}
+
+// create an empty list using the same storage mode and allocator as 'sl'
+StringList *_list_new_like(const StringList *sl, const int capacity) {
+	StringList *result = listNewWithAllocator(capacity, &sl->allocator);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	if (sl->cells != NULL) {
+		return _list_use_cells(result);
+	}
+	if (sl->arena != NULL) {
+		return _list_use_arena(result, sl->arena->chunk_size);
+	}
+	return result;
+}
+
+// an empty list that listSortedInsert keeps in 'comparator_funct' order
+StringList *listNewSorted(const int capacity, int (*comparator_funct)(const char *, const char *)) {
+	_LIST_TRACE(listNewSorted, NULL, capacity);
+	StringList *result = listNewCapacity(capacity);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	result->sorted_by = comparator_funct;
+	return result;
+}
+
+StringList *listNew() {
+	_LIST_TRACE(listNew, NULL, 0);
+	return listNewCapacity(10);
+}
+
+StringList *listSublist(const StringList *sl, const int from, const int to) {
+	_LIST_TRACE(listSublist, sl, sl->length);
+	assert(from >= 0); // make sure the 'from' index is not negative
+	assert(to <= sl->length); // make sure 'to' is an existing index in 'list'
+	assert(to >= from); // an empty range gives an empty list
+
+	// initialize a new StringList with initial capacity exactly the finished size
+	StringList *result = _list_new_like(sl, (to - from));
+	if (result == NULL) {
+		return NULL;
+	}
+
+	for (int i = from; i < to; i++) { // for each index in [to, from)
+		// add this element from the master list to the sublist
+		if (listAdd(result, sl->list[i]) == NULL) {
+			listDestroy(result);
+			return NULL;
+		}
+	}
+
+	result->sorted_by = sl->sorted_by; // any range of a sorted list is sorted the same way
+	result->growth = sl->growth;
+	result->max_step = sl->max_step;
+	result->shrink_below = sl->shrink_below;
+	result->reserved = sl->reserved;
+
+	if ((sl->index != NULL) && (listEnableIndex(result) == NULL)) {
+		listDestroy(result);
+		return NULL;
+	}
+	if ((sl->hashes != NULL) && (listEnableMetadata(result) == NULL)) {
+		listDestroy(result);
+		return NULL;
+	}
+
+	return result;
+}
+
+// return a clone of the entire original list, sharing its storage until either one is modified
+StringList *listClone(const StringList *sl) {
+	_LIST_TRACE(listClone, sl, sl->length);
+	StringList *result = _list_alloc(&sl->allocator, sizeof(StringList));
+	if (result == NULL) {
+		return NULL;
+	}
+
+	atomic_fetch_add(&sl->share->refs, 1); // the record exists from creation, nothing of 'sl' itself is written
+	*result = *sl;
+	return result;
+}
+
+void listDestroy(StringList *sl) {
+	_LIST_TRACE(listDestroy, sl, sl->length);
+	_list_share_release(sl); // only frees the storage if no other list uses it
+	ListAllocator allocator = sl->allocator;
+	_list_free(&allocator, sl); // free struct memory
+}
+
+
+// beware: providing a capacity less than the current List's length will drop the overflow elements
+StringList *listSetCapacity(StringList *sl, const int capacity) {
+	_LIST_TRACE(listSetCapacity, sl, sl->length);
+	if (!_list_unshare_keeping(sl, ((capacity < sl->length) ? capacity : sl->length))) {
+		return NULL;
+	}
+
+	_list_linearize(sl); // the allocation is resized from its start
+
+	if (capacity < sl->length) { // if the new capacity is less than the current length
+		// new capacity is the first index to be dropped, continue to the end of the current internal list
+		for (int i = capacity; i < sl->length; i++) {
+			// release the element's buffer to prevent leak
+			_list_drop_element(sl, i);
+		}
+		sl->length = capacity; // update the length field
+		_list_index_settle(sl); // a dropped element may have been the last occurrence of a kept one
+	}
+
+	// metadata arrays larger than the capacity are harmless, smaller ones are not: grow them first, shrink them last
+	bool growing = (capacity > sl->capacity);
+	if (growing && (sl->hashes != NULL) && !_list_meta_resize(sl, capacity)) {
+		return NULL;
+	}
+
+	// resize the memory allocated to this StringList's internal list
+	_LIST_COUNT(sl, allocations, 1);
+	// realloc to zero bytes may free the block and return NULL, keep at least one slot
+	char **newList = _list_realloc(&sl->allocator, sl->list, (((capacity > 0) ? capacity : 1) * sizeof(char*)));
+	if (newList == NULL) {
+		return NULL;
+	}
+
+	sl->list = newList;
+	sl->capacity = capacity;
+	if (sl->reserved > capacity) {
+		sl->reserved = capacity; // an explicit capacity replaces any earlier reservation
+	}
+
+	if (!growing && (sl->hashes != NULL) && !_list_meta_resize(sl, capacity)) {
+		return NULL;
+	}
+
+	// inline lists keep exactly one cell per slot of capacity
+	if ((sl->cells != NULL) && (sl->cells->count != capacity)) {
+		if (_list_cells_resize(sl, capacity) == NULL) {
+			return NULL;
+		}
+	}
+
+	return sl;
+}
+
+/**
+	capacity policy: a full list grows to 'growth' times its capacity plus one (2x by default),
+	adding at most 'max_step' slots at once when that is set. with a shrink policy, a removal
+	that leaves the list under 'shrink_below' of its allocation shrinks it back to one growth
+	step above its length, so it takes another growth and drain before the next reallocation.
+	auto-shrink never goes below LIST_SHRINK_FLOOR slots or below a listEnsureCapacity reservation.
+**/
+
+#define LIST_SHRINK_FLOOR 16
+
+// capacity to grow to when the list is full, at least 'needed'
+int _list_grown_capacity(const StringList *sl, const int needed) {
+	long long grown = (long long) (sl->capacity * sl->growth) + 1;
+	if ((sl->max_step > 0) && (grown > ((long long) sl->capacity + sl->max_step))) {
+		grown = (long long) sl->capacity + sl->max_step;
+	}
+	if (grown < needed) {
+		grown = needed;
+	}
+	return (grown < INT_MAX) ? (int) grown : INT_MAX;
+}
+
+// make room for at least 'capacity' elements, growing by the policy so repeated bulk adds stay amortized
+StringList *_list_reserve(StringList *sl, const int capacity) {
+	if (capacity <= (sl->capacity - sl->head)) {
+		return sl;
+	}
+	if (capacity <= sl->capacity) { // the room is there, just in front of the elements
+		if (!_list_unshare(sl)) {
+			return NULL;
+		}
+		_list_linearize(sl);
+		return sl;
+	}
+	return listSetCapacity(sl, _list_grown_capacity(sl, capacity));
+}
+
+// give memory back after removals, if the shrink policy asks for it
+void _list_maybe_shrink(StringList *sl) {
+	int allocated = sl->capacity;
+	if ((sl->shrink_below == 0) || (allocated <= LIST_SHRINK_FLOOR) || (sl->length >= (allocated * sl->shrink_below))) {
+		return;
+	}
+
+	long long target = (long long) (sl->length * sl->growth) + 1;
+	if (target < LIST_SHRINK_FLOOR) {
+		target = LIST_SHRINK_FLOOR;
+	}
+	if (target < sl->reserved) {
+		target = sl->reserved;
+	}
+	if (target < allocated) {
+		listSetCapacity(sl, (int) target); // keeping the larger allocation on failure is harmless
+	}
+}
+
+// grow full lists by 'factor' times their capacity, adding no more than 'max_step' slots at once (0 for no limit)
+StringList *listSetGrowthPolicy(StringList *sl, const double factor, const int max_step) {
+	_LIST_TRACE(listSetGrowthPolicy, sl, sl->length);
+	assert(factor > 1.0);
+	assert(max_step >= 0);
+	assert((sl->shrink_below * factor) < 1.0); // a shrunk list must not be over the threshold again
+
+	sl->growth = factor;
+	sl->max_step = max_step;
+	return sl;
+}
+
+// shrink the list after removals leave fewer than 'below' * capacity elements, 0 turns shrinking off
+StringList *listSetShrinkPolicy(StringList *sl, const double below) {
+	_LIST_TRACE(listSetShrinkPolicy, sl, sl->length);
+	assert(below >= 0);
+	assert((below * sl->growth) < 1.0); // leave a gap between the shrink and growth points
+
+	sl->shrink_below = below;
+	_list_maybe_shrink(sl);
+	return sl;
+}
+
+// reserve room for 'capacity' elements, auto-shrink will keep at least that much
+StringList *listEnsureCapacity(StringList *sl, const int capacity) {
+	_LIST_TRACE(listEnsureCapacity, sl, sl->length);
+	if (capacity > sl->reserved) {
+		sl->reserved = capacity;
+	}
+	if (capacity > sl->capacity) {
+		return listSetCapacity(sl, capacity);
+	} else {
+		return _list_reserve(sl, capacity); // at most moves the elements back over the head room
+	}
+}
+
+StringList *listTrimCapacity(StringList *sl) {
+	_LIST_TRACE(listTrimCapacity, sl, sl->length);
+	return listSetCapacity(sl, sl->length);
+}
+
+StringList *_list_expand_auto(StringList *sl) {
+	if ((sl->head > 0) && (sl->head >= sl->length)) {
+		// at least half of the allocation is head room left by front removals, reuse it instead
+		_list_linearize(sl);
+		return sl;
+	}
+
+	sl->counters.expansions++;
+	return listSetCapacity(sl, _list_grown_capacity(sl, (sl->length + 1)));
+}
+
+
+// put 'buffer', which already belongs to the list's storage, into the slot at 'index'
+StringList *_list_store(StringList *sl, const int index, char *buffer) {
+	sl->list[index] = buffer; // set the pointer at the next index in the list to the new buffer
+	_list_meta_store(sl, index);
+	_list_index_stored(sl, index);
+	_list_index_settle(sl); // an overwrite or insert may have moved the first/last occurrence
+	sl->sorted_by = NULL; // an arbitrary value may break the order, listSortedInsert restores the flag
+	return sl;
+}
+
+StringList *_list_set_unchecked(StringList *sl, const int index, const char *value) {
+
+	// create a buffer for a copy of the 'value' string
+	char *copyBuf = _list_alloc_string(sl, (strlen(value) + 1));
+	if (copyBuf == NULL) {
+		return NULL;
+	}
+
+	strcpy(copyBuf, value); // copy the 'value' string into the buffer
+	return _list_store(sl, index, copyBuf);
+}
+
+/*
+	ownership transfer: the *Owned functions store a caller's buffer as the element itself instead
+	of copying it, and listTake hands an element's buffer back without freeing it. these buffers
+	always belong to the list's allocator (plain malloc for lists created without one). arena
+	lists can only hold arena memory, so there the buffer is copied in and freed instead.
+*/
+
+// the buffer to store for an adopted heap string 'value', or NULL if memory ran out (then 'value' is untouched)
+char *_list_adopt(StringList *sl, char *value) {
+	if (sl->arena == NULL) { // heap and inline lists free non-inline buffers themselves
+		return ((sl->borrowed == NULL) || _list_borrow_own(sl, value)) ? value : NULL;
+	}
+
+	size_t size = strlen(value) + 1;
+	char *copyBuf = _list_arena_alloc(sl->arena, size);
+	if ((copyBuf == NULL) || ((sl->borrowed != NULL) && !_list_borrow_own(sl, copyBuf))) {
+		return NULL;
+	}
+	memcpy(copyBuf, value, size);
+	_list_free(&sl->allocator, value);
+	return copyBuf;
+}
+
+StringList *listSet(StringList *sl, const int index, const char *value) {
+	_LIST_TRACE(listSet, sl, sl->length);
+	// note: copies the 'value' string to make sure values are available until removed from the list
+	// printf("setting index '%d' (len = '%d')\n", index, list->length);
+	// lists can only be expanded one at a time by passing their current length as an index
+	assert(index <= sl->length);
+	assert(index >= 0);
+
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	// if this is a set() call for the n+1 element index (special case mentioned above)
+	if (index == sl->length) {
+		// if more capacity will be needed to store something at this index
+		if (_list_tail_room(sl) == 0) {
+			// expand the capacity to an automatically determined larger size
+		 	if (_list_expand_auto(sl) == NULL) {
+		 		return NULL;
+		 	}
+		}
+	}
+
+	// copy 'value' before touching the slot, so a failed copy leaves the list as it was
+	// (and 'value' may be the very element being overwritten)
+	char *copyBuf = _list_alloc_string(sl, (strlen(value) + 1));
+	if (copyBuf == NULL) {
+		return NULL;
+	}
+	strcpy(copyBuf, value);
+
+	if (index == sl->length) {
+		sl->length++; // there is a new valid index
+	} else { // if this set() call will overwrite an existing element in the list
+		_list_drop_element(sl, index); // release the memory at the pointer to be overwritten
+	}
+
+	return _list_store(sl, index, copyBuf);
+}
+
+// like listSet, but the list takes over the buffer 'value' instead of copying it
+// on failure the caller still owns 'value'
+StringList *listSetOwned(StringList *sl, const int index, char *value) {
+	_LIST_TRACE(listSetOwned, sl, sl->length);
+	assert(index <= sl->length);
+	assert(index >= 0);
+
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	// make room before adopting, so a failed expansion leaves 'value' with the caller
+	if ((index == sl->length) && (_list_tail_room(sl) == 0) && (_list_expand_auto(sl) == NULL)) {
+		return NULL;
+	}
+
+	char *buffer = _list_adopt(sl, value);
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	if (index == sl->length) {
+		sl->length++;
+	} else {
+		_list_drop_element(sl, index);
+	}
+
+	return _list_store(sl, index, buffer);
+}
+
+StringList *listAdd(StringList *sl, const char *value) {
+	_LIST_TRACE(listAdd, sl, sl->length);
+	return listSet(sl, sl->length, value);
+}
+
+StringList *listAddOwned(StringList *sl, char *value) {
+	_LIST_TRACE(listAddOwned, sl, sl->length);
+	return listSetOwned(sl, sl->length, value);
+}
+
+StringList *listAddAll(StringList *sl, const StringList *src) {
+	_LIST_TRACE(listAddAll, sl, sl->length);
+	if (_list_reserve(sl, (sl->length + src->length)) == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < src->length; i++) {
+		if (listAdd(sl, src->list[i]) == NULL) {
+			return NULL;
+		}
+	}
+	return sl;
+}
+
+/*
+	move every element of 'src' to the end of 'dst', leaving 'src' empty. when both lists keep
+	their strings in separate heap buffers the pointers are spliced over in one block move, with
+	no per-string allocation or copy; otherwise the strings are copied and 'src' is cleared.
+*/
+StringList *listMoveAll(StringList *dst, StringList *src) {
+	_LIST_TRACE(listMoveAll, dst, dst->length);
+	assert(dst != src);
+
+	if (!_list_unshare(dst)) {
+		return NULL;
+	}
+
+	if ((src->arena != NULL) || (src->cells != NULL) || (src->mapping != NULL) || (dst->arena != NULL) || !_list_sole_holder(src) ||
+		(src->borrowed != NULL) || (dst->borrowed != NULL) || !_list_same_allocator(&dst->allocator, &src->allocator)) {
+		// 'src' buffers live in its own storage, are still read by a clone or borrowed from one, or can't be freed by 'dst',
+		// or 'dst' borrows and would have to record every one of them as its own
+		int destLen = dst->length;
+		if (listAddAll(dst, src) == NULL) {
+			listRemoveRange(dst, destLen, dst->length); // drop the copies that were made, 'src' keeps every element
+			return NULL;
+		}
+		listClear(src);
+		return dst;
+	}
+
+	int destLen = dst->length;
+	int srcLen = src->length;
+	if (_list_reserve(dst, (destLen + srcLen)) == NULL) {
+		return NULL;
+	}
+
+	memcpy(&dst->list[destLen], src->list, (srcLen * sizeof(char*)));
+	if ((dst->hashes != NULL) && (src->hashes != NULL)) {
+		memcpy(&dst->hashes[destLen], src->hashes, (srcLen * sizeof(uint32_t)));
+		memcpy(&dst->lengths[destLen], src->lengths, (srcLen * sizeof(uint32_t)));
+	} else {
+		for (int i = destLen; i < (destLen + srcLen); i++) {
+			_list_meta_store(dst, i);
+		}
+	}
+	for (int i = destLen; i < (destLen + srcLen); i++) {
+		_list_index_stored(dst, i);
+	}
+	dst->length += srcLen;
+	if (srcLen > 0) {
+		dst->sorted_by = NULL;
+	}
+
+	// the buffers now belong to 'dst', forget them without releasing anything
+	if (src->index != NULL) {
+		_list_index_clear(src->index);
+	}
+	src->length = 0;
+	_list_linearize(src);
+	_list_maybe_shrink(src);
+	return dst;
+}
+
+// open head room in front of element 0, growing the allocation when there is too little slack to share
+StringList *_list_make_room_front(StringList *sl) {
+	if ((_list_tail_room(sl) * 2) < (sl->length + 2)) {
+		sl->counters.expansions++;
+		if (listSetCapacity(sl, _list_grown_capacity(sl, (sl->length + 2))) == NULL) {
+			return NULL;
+		}
+	}
+
+	// split the free slots between both ends
+	int room = (_list_tail_room(sl) + 1) / 2;
+	_list_move_slots(sl, room, 0, sl->length);
+	_list_advance_head(sl, room);
+	return sl;
+}
+
+// shift elements to open an uninitialized slot at 'index', the caller fills it and bumps the length
+StringList *_list_open_slot(StringList *sl, const int index) {
+	if (index < (sl->length / 2)) {
+		// fewer elements in front of the index: take a slot from the head room and move those down
+		if ((sl->head == 0) && (_list_make_room_front(sl) == NULL)) {
+			return NULL;
+		}
+		_list_advance_head(sl, -1);
+		_list_move_slots(sl, 0, 1, index);
+	} else {
+		// make sure there's room for the added element
+		if (_list_tail_room(sl) == 0) {
+			if (_list_expand_auto(sl) == NULL) { // expand the capacity
+				return NULL;
+			}
+		}
+
+		// no copy needed, just move the existing pointers up one slot
+		_list_move_slots(sl, (index + 1), index, (sl->length - index));
+	}
+	_list_index_shifted(sl);
+	return sl;
+}
+
+void _list_close_gap(StringList *sl, const int from, const int to);
+
+StringList *listInsert(StringList *sl, const int index, const char *value) {
+	_LIST_TRACE(listInsert, sl, sl->length);
+	assert(index < sl->length);
+	assert(index >= 0);
+
+	if (!_list_unshare(sl) || (_list_open_slot(sl, index) == NULL)) {
+		return NULL;
+	}
+
+	sl->length++; // increment the length, as one element has been added to the list
+
+	// set the value at this index to a copy of the 'value' string
+	if (_list_set_unchecked(sl, index, value) == NULL) {
+		_list_close_gap(sl, index, (index + 1)); // put the other elements back
+		return NULL;
+	}
+	return sl;
+}
+
+// like listInsert, but the list takes over the buffer 'value' instead of copying it
+StringList *listInsertOwned(StringList *sl, const int index, char *value) {
+	_LIST_TRACE(listInsertOwned, sl, sl->length);
+	assert(index < sl->length);
+	assert(index >= 0);
+
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	// open the slot before adopting, so every failure leaves 'value' with the caller
+	if (_list_open_slot(sl, index) == NULL) {
+		return NULL;
+	}
+	sl->length++;
+
+	char *buffer = _list_adopt(sl, value);
+	if (buffer == NULL) {
+		_list_close_gap(sl, index, (index + 1));
+		return NULL;
+	}
+	return _list_store(sl, index, buffer);
+}
+
+StringList *listInsertAll(StringList *sl, const int index, const StringList *src) {
+	_LIST_TRACE(listInsertAll, sl, sl->length);
+	assert(index < sl->length);
+	assert(index >= 0);
+
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	int destLen = sl->length;
+	int srcLen = src->length;
+
+	// make sure the destination has enough space for both sets of elements
+	if (_list_reserve(sl, (destLen + srcLen)) == NULL) {
+		return NULL;
+	}
+
+	// move everything from the insert index to the end of the new list in one block
+	_list_move_slots(sl, (index + srcLen), index, (destLen - index));
+
+	// copy-insert each string from src to dest
+	for (int o = 0; o < srcLen; o++) {
+		if (_list_set_unchecked(sl, (index + o), src->list[o]) == NULL) {
+			// release the copies made so far and put the other elements back
+			for (int c = 0; c < o; c++) {
+				_list_drop_element(sl, (index + c));
+			}
+			sl->length += srcLen;
+			_list_index_shifted(sl);
+			_list_close_gap(sl, index, (index + srcLen));
+			return NULL;
+		}
+	}
+
+	sl->length += srcLen;
+	_list_index_shifted(sl); // only now is every moved element back in a valid slot
+	_list_index_settle(sl);
+	return sl;
+}
+
+
+int listCapacity(const StringList *sl) {
+	_LIST_TRACE(listCapacity, sl, sl->length);
+	return sl->capacity;
+}
+
+int listLength(const StringList *sl) {
+	_LIST_TRACE(listLength, sl, sl->length);
+	return sl->length;
+}
+
+char *listGet(const StringList *sl, const int index) {
+	_LIST_TRACE(listGet, sl, sl->length);
+	assert(index < sl->length); // make sure the index being retrieved actually exists
+	assert(index >= 0);
+
+	return sl->list[index];
+}
+
+int listIndexOf(const StringList *sl, const char *element) {
+	_LIST_TRACE(listIndexOf, sl, sl->length);
+	if (sl->index != NULL) {
+		ListIndexEntry *entry = _list_index_find(sl->index, element);
+		if (entry == NULL) {
+			return -1;
+		}
+		assert(sl->index->positions_valid); // every mutation settles the positions before returning
+		return (entry->first - sl->index->base);
+	}
+
+	if (sl->sorted_by == &strcmp) { // byte-wise sorted: equal under strcmp means identical
+		return listBinarySearch(sl, element);
+	}
+
+	return _list_scan(sl, 0, sl->length, element, false);
+}
+
+int listLastIndexOf(const StringList *sl, const char *element) {
+	_LIST_TRACE(listLastIndexOf, sl, sl->length);
+	if (sl->index != NULL) {
+		ListIndexEntry *entry = _list_index_find(sl->index, element);
+		if (entry == NULL) {
+			return -1;
+		}
+		assert(sl->index->positions_valid);
+		return (entry->last - sl->index->base);
+	}
+
+	if (sl->sorted_by == &strcmp) {
+		int index = listUpperBound(sl, element) - 1;
+		return ((index >= 0) && (strcmp(sl->list[index], element) == 0)) ? index : -1;
+	}
+
+	return _list_scan(sl, 0, sl->length, element, true);
+}
+
+
+bool listIsEmpty(const StringList *sl) {
+	_LIST_TRACE(listIsEmpty, sl, sl->length);
+	return (sl->length == 0);
+}
+
+bool listContains(const StringList *sl, const char *element) {
+	_LIST_TRACE(listContains, sl, sl->length);
+	if (sl->index != NULL) {
+		return (_list_index_find(sl->index, element) != NULL); // counts are always exact, no refresh needed
+	}
+	return (listIndexOf(sl, element) != -1); // index_of returns -1 if the element was not found
+}
+
+/*
+	set engine: for each element of 'sl', whether it occurs anywhere in 'other'.
+	a temporary hash set is built over the smaller of the two lists (or the existing index
+	of 'other' is used), so the whole computation is O(n + m) instead of O(n * m).
+	returns an array of sl->length flags from the allocator of 'sl', or NULL if memory ran out.
+*/
+bool *_list_membership(const StringList *sl, const StringList *other) {
+	bool *marks = _list_alloc(&sl->allocator, ((sl->length > 0 ? sl->length : 1) * sizeof(bool)));
+	if (marks == NULL) {
+		return NULL;
+	}
+
+	if ((other->index != NULL) || (other->length <= sl->length)) {
+		// probe a set of 'other' with each element of 'sl'
+		ListIndex *set = (other->index != NULL) ? other->index : _list_index_build(other, false);
+		if (set == NULL) {
+			_list_free(&sl->allocator, marks);
+			return NULL;
+		}
+
+		for (int i = 0; i < sl->length; i++) {
+			marks[i] = (_list_index_find(set, sl->list[i]) != NULL);
+		}
+
+		if (set != other->index) {
+			_list_index_destroy(set);
+		}
+		return marks;
+	}
+
+	// 'sl' is the smaller side: build the set over it and flag the keys 'other' hits
+	ListIndex *set = _list_index_build(sl, false);
+	if (set == NULL) {
+		_list_free(&sl->allocator, marks);
+		return NULL;
+	}
+
+	for (int i = 0; i < set->slots; i++) {
+		set->entries[i].first = 0; // positions are not needed, reuse 'first' as the hit flag
+	}
+	for (int i = 0; i < other->length; i++) {
+		ListIndexEntry *entry = _list_index_find(set, other->list[i]);
+		if (entry != NULL) {
+			entry->first = 1;
+		}
+	}
+	for (int i = 0; i < sl->length; i++) {
+		marks[i] = (_list_index_find(set, sl->list[i])->first == 1);
+	}
+
+	_list_index_destroy(set);
+	return marks;
+}
+
+bool listContainsAll(const StringList *sl, const StringList *must_contain) {
+	_LIST_TRACE(listContainsAll, sl, sl->length);
+	bool *marks = _list_membership(must_contain, sl);
+	if (marks != NULL) {
+		bool result = true;
+		for (int i = 0; (i < must_contain->length) && result; i++) {
+			result = marks[i];
+		}
+		_list_free(&must_contain->allocator, marks);
+		return result;
+	}
+
+	// out of memory for the set, fall back to probing one element at a time
+	for (int i = 0; i < must_contain->length; i++) { // for each index in the must_contain List
+		// if the target list does not contain this element
+		if (!listContains(sl, must_contain->list[i])) {
+			return false; // the list does not "contain all"
+		}
+	}
+
+	// if no missing elements were found, 'list' contains all elements in 'must_contain'
+	return true;
+}
+
+// whether the 'count' elements from 'from_a' in 'sl_a' equal those from 'from_b' in 'sl_b'
+bool _list_range_equals(const StringList *sl_a, const int from_a, const StringList *sl_b, const int from_b, const int count) {
+	if ((sl_a->hashes != NULL) && (sl_b->hashes != NULL)) {
+		// both sides carry metadata: reject on hash or length before reading any string
+		for (int i = 0; i < count; i++) {
+			int b = from_b + i;
+			if (!_list_element_equals(sl_a, (from_a + i), sl_b->list[b], sl_b->hashes[b], sl_b->lengths[b])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	for (int i = 0; i < count; i++) { // for each index in both Lists
+		_LIST_COUNT(sl_a, compares, 1);
+		// if the strings at this index in both Lists are not equal to each other
+		if (strcmp(sl_a->list[(from_a + i)], sl_b->list[(from_b + i)]) != 0) {
+			return false; // the Lists are not equal
+		}
+	}
+
+	return true; // if no mismatches were found, the Lists are equal
+}
+
+bool listEquals(const StringList *sl_a, const StringList *sl_b) {
+	_LIST_TRACE(listEquals, sl_a, sl_a->length);
+	if (sl_a->length != sl_b->length) { // the Lists cannot be equal if their lengths aren't equal
+		return false;
+	}
+
+	return _list_range_equals(sl_a, 0, sl_b, 0, sl_a->length);
+}
+
+
+/**
+	views: a StringListView is a [from, to) window over a parent list that borrows its slots,
+	so creating one is O(1) and allocates nothing. a view is only valid until the parent is
+	next modified or destroyed; listSublist makes an independent copy when one is needed.
+**/
+
+StringListView listView(const StringList *sl, const int from, const int to) {
+	_LIST_TRACE(listView, sl, sl->length);
+	assert(from >= 0);
+	assert(to <= sl->length);
+	assert(to >= from);
+
+	StringListView view = { sl, from, to };
+	return view;
+}
+
+int viewLength(const StringListView view) {
+	_LIST_TRACE(viewLength, view.list, (view.to - view.from));
+	return (view.to - view.from);
+}
+
+char *viewGet(const StringListView view, const int index) {
+	_LIST_TRACE(viewGet, view.list, (view.to - view.from));
+	assert(index >= 0);
+	assert(index < (view.to - view.from));
+
+	return view.list->list[(view.from + index)];
+}
+
+// index of 'element' relative to the start of the view, or -1
+int viewIndexOf(const StringListView view, const char *element) {
+	_LIST_TRACE(viewIndexOf, view.list, (view.to - view.from));
+	const StringList *sl = view.list;
+	if ((sl->index != NULL) && (_list_index_find(sl->index, element) == NULL)) {
+		return -1; // not anywhere in the parent
+	}
+
+	int index = _list_scan(sl, view.from, view.to, element, false);
+	return (index != -1) ? (index - view.from) : -1;
+}
+
+int viewLastIndexOf(const StringListView view, const char *element) {
+	_LIST_TRACE(viewLastIndexOf, view.list, (view.to - view.from));
+	const StringList *sl = view.list;
+	if ((sl->index != NULL) && (_list_index_find(sl->index, element) == NULL)) {
+		return -1;
+	}
+
+	int index = _list_scan(sl, view.from, view.to, element, true);
+	return (index != -1) ? (index - view.from) : -1;
+}
+
+bool viewContains(const StringListView view, const char *element) {
+	_LIST_TRACE(viewContains, view.list, (view.to - view.from));
+	return (viewIndexOf(view, element) != -1);
+}
+
+bool viewEquals(const StringListView view_a, const StringListView view_b) {
+	_LIST_TRACE(viewEquals, view_a.list, (view_a.to - view_a.from));
+	int length = view_a.to - view_a.from;
+	if (length != (view_b.to - view_b.from)) {
+		return false;
+	}
+
+	return _list_range_equals(view_a.list, view_a.from, view_b.list, view_b.from, length);
+}
+
+
+// remove the slots [from, to), whose buffers have already been released or handed out
+void _list_close_gap(StringList *sl, const int from, const int to) {
+	if (from < (sl->length - to)) {
+		// fewer elements in front of the range: move those up over the gap and advance the start
+		_list_move_slots(sl, (to - from), 0, from);
+		_list_advance_head(sl, (to - from));
+	} else {
+		// close the gap with a single block move of the tail
+		_list_move_slots(sl, from, to, (sl->length - to));
+	}
+	if ((from == 0) && (sl->index != NULL) && (sl->index->base <= (INT_MAX - to))) {
+		sl->index->base += to; // every remaining element moved down by 'to'
+	} else if ((to > from) && (to < sl->length)) {
+		_list_index_shifted(sl);
+	}
+	sl->length -= (to - from);
+	_list_index_settle(sl);
+	_list_maybe_shrink(sl);
+}
+
+void listRemove(StringList *sl, const int index) {
+	_LIST_TRACE(listRemove, sl, sl->length);
+	assert(index >= 0);
+	assert(index < sl->length); // make sure the index to be deleted actually exists
+
+	listRemoveRange(sl, index, (index + 1));
+}
+
+void listRemoveElement(StringList *sl, const char *element) {
+	_LIST_TRACE(listRemoveElement, sl, sl->length);
+	int index = listIndexOf(sl, element);
+	if (index != -1) { // if the element exists
+		listRemove(sl, index);
+	}
+}
+
+void listRemoveRange(StringList *sl, const int from, const int to) {
+	_LIST_TRACE(listRemoveRange, sl, sl->length);
+	assert(from >= 0);
+	assert(to <= sl->length); // make sure 'to' does not run past the end of the list
+	assert(to >= from);
+
+	if (!_list_unshare(sl)) {
+		return;
+	}
+
+	for (int i = from; i < to; i++) {
+		_list_drop_element(sl, i); // release each buffer in [from, to)
+	}
+
+	_list_close_gap(sl, from, to);
+}
+
+// remove the element at 'index' and return its buffer instead of freeing it, the caller releases it
+// arena, inline and borrowed elements come back as a heap copy; returns NULL (removing nothing) if that copy fails
+char *listTake(StringList *sl, const int index) {
+	_LIST_TRACE(listTake, sl, sl->length);
+	assert(index >= 0);
+	assert(index < sl->length);
+
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	char *value = sl->list[index];
+	bool in_storage = (sl->arena != NULL) || ((sl->cells != NULL) && (_list_cell_index(sl->cells, value) >= 0)) ||
+		_list_is_borrowed(sl, value);
+	if (in_storage) {
+		char *copyBuf = _list_alloc(&sl->allocator, (strlen(value) + 1));
+		if (copyBuf == NULL) {
+			return NULL;
+		}
+		strcpy(copyBuf, value);
+		_list_drop_element(sl, index); // the list's own copy goes back to its storage
+		value = copyBuf;
+	} else {
+		_list_borrow_forget(sl, value); // not borrowed, but no longer one of the list's own buffers either
+		if (sl->index != NULL) {
+			_list_index_remove(sl->index, value, index);
+		}
+	}
+
+	_list_close_gap(sl, index, (index + 1));
+	return value;
+}
+
+// stable one-pass compaction: drops every element for which 'matches' returns true
+void _list_compact(StringList *sl, bool (*matches)(const char *, const int, const void *), const void *context) {
+	int kept = 0;
+	for (int i = 0; i < sl->length; i++) {
+		if (matches(sl->list[i], i, context)) {
+			_list_drop_element(sl, i);
+		} else {
+			if (kept != i) {
+				_list_move_slots(sl, kept, i, 1); // slide survivors down over the dropped slots
+			}
+			kept++;
+		}
+	}
+	if (kept != sl->length) {
+		_list_index_shifted(sl);
+	}
+	sl->length = kept;
+	_list_index_settle(sl);
+	_list_maybe_shrink(sl);
+}
+
+typedef struct {
+	const StringList *sl;
+	const char *element;
+	uint32_t hash;
+	uint32_t length;
+} _ListProbe;
+
+bool _list_matches_string(const char *value, const int index, const void *probe) {
+	const _ListProbe *p = probe;
+	return _list_element_equals(p->sl, index, p->element, p->hash, p->length);
+}
+
+bool _list_matches_list(const char *value, const int index, const void *to_remove) {
+	return listContains(to_remove, value);
+}
+
+bool _list_matches_marked(const char *value, const int index, const void *marks) {
+	return ((const bool *) marks)[index];
+}
+
+bool _list_matches_unmarked(const char *value, const int index, const void *marks) {
+	return !((const bool *) marks)[index];
+}
+
+typedef struct {
+	bool (*conditional_funct)(const char *);
+} _ListPredicate;
+
+bool _list_matches_predicate(const char *value, const int index, const void *predicate) {
+	return ((const _ListPredicate *) predicate)->conditional_funct(value);
+}
+
+void listRemoveElements(StringList *sl, const char *element) {
+	_LIST_TRACE(listRemoveElements, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return;
+	}
+
+	_ListProbe probe = { sl, element, 0, 0 };
+	_list_probe(sl, element, &probe.hash, &probe.length);
+
+	if (sl->hashes != NULL) {
+		// jump between matches with the search kernel and move each run of survivors as one block
+		int kept = 0;
+		int i = 0;
+		while (i < sl->length) {
+			int hit = _list_scan_hashed(sl, i, sl->length, element, probe.hash, probe.length, false);
+			if (hit == -1) {
+				hit = sl->length;
+			}
+			if (kept != i) {
+				_list_move_slots(sl, kept, i, (hit - i));
+			}
+			kept += (hit - i);
+			if (hit < sl->length) {
+				_list_drop_element(sl, hit);
+			}
+			i = (hit + 1);
+		}
+		if (kept != sl->length) {
+			_list_index_shifted(sl);
+		}
+		sl->length = kept;
+		_list_index_settle(sl);
+		_list_maybe_shrink(sl);
+		return;
+	}
+
+	_list_compact(sl, &_list_matches_string, &probe);
+}
+
+void listRemoveAll(StringList *sl, const StringList *to_remove) {
+	_LIST_TRACE(listRemoveAll, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return;
+	}
+
+	bool *marks = _list_membership(sl, to_remove);
+	if (marks == NULL) {
+		_list_compact(sl, &_list_matches_list, to_remove); // out of memory for the set, probe one by one
+		return;
+	}
+
+	_list_compact(sl, &_list_matches_marked, marks);
+	_list_free(&sl->allocator, marks);
+}
+
+StringList *listRetainAll(StringList *sl, const StringList *to_keep) {
+	_LIST_TRACE(listRetainAll, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	bool *marks = _list_membership(sl, to_keep);
+	if (marks == NULL) {
+		return NULL;
+	}
+
+	_list_compact(sl, &_list_matches_unmarked, marks);
+	_list_free(&sl->allocator, marks);
+	return sl;
+}
+
+// new list of the elements of 'sl' for which marks[i] == wanted, in their original order
+StringList *_list_select(const StringList *sl, const bool *marks, const bool wanted) {
+	int count = 0;
+	for (int i = 0; i < sl->length; i++) {
+		count += (marks[i] == wanted);
+	}
+
+	StringList *result = _list_new_like(sl, count);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < sl->length; i++) {
+		if ((marks[i] == wanted) && (listAdd(result, sl->list[i]) == NULL)) {
+			listDestroy(result);
+			return NULL;
+		}
+	}
+	return result;
+}
+
+// elements of 'sl_a' that also occur in 'sl_b', in the order of 'sl_a'
+StringList *listIntersection(const StringList *sl_a, const StringList *sl_b) {
+	_LIST_TRACE(listIntersection, sl_a, sl_a->length);
+	bool *marks = _list_membership(sl_a, sl_b);
+	if (marks == NULL) {
+		return NULL;
+	}
+
+	StringList *result = _list_select(sl_a, marks, true);
+	_list_free(&sl_a->allocator, marks);
+	return result;
+}
+
+// elements of 'sl_a' that do not occur in 'sl_b', in the order of 'sl_a'
+StringList *listDifference(const StringList *sl_a, const StringList *sl_b) {
+	_LIST_TRACE(listDifference, sl_a, sl_a->length);
+	bool *marks = _list_membership(sl_a, sl_b);
+	if (marks == NULL) {
+		return NULL;
+	}
+
+	StringList *result = _list_select(sl_a, marks, false);
+	_list_free(&sl_a->allocator, marks);
+	return result;
+}
+
+// every element of 'sl_a', followed by the elements of 'sl_b' that do not occur in 'sl_a'
+StringList *listUnion(const StringList *sl_a, const StringList *sl_b) {
+	_LIST_TRACE(listUnion, sl_a, sl_a->length);
+	bool *marks = _list_membership(sl_b, sl_a);
+	if (marks == NULL) {
+		return NULL;
+	}
+
+	StringList *result = listSublist(sl_a, 0, sl_a->length); // about to be modified, sharing would not pay off
+	for (int i = 0; (i < sl_b->length) && (result != NULL); i++) {
+		if (!marks[i] && (listAdd(result, sl_b->list[i]) == NULL)) {
+			listDestroy(result);
+			result = NULL;
+		}
+	}
+
+	_list_free(&sl_b->allocator, marks);
+	return result;
+}
+
+void listRemoveIf(StringList *sl, bool (*conditional_funct)(const char *)) {
+	_LIST_TRACE(listRemoveIf, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return;
+	}
+
+	_ListPredicate predicate = { conditional_funct };
+	_list_compact(sl, &_list_matches_predicate, &predicate);
+}
+
+void listClear(StringList *sl) {
+	_LIST_TRACE(listClear, sl, sl->length);
+	if (!_list_unshare_keeping(sl, 0)) { // a shared list copies nothing
+		return;
+	}
+
+	if (sl->arena != NULL) {
+		_list_arena_free_chunks(sl->arena); // drop every element buffer in one go
+		if (sl->index != NULL) {
+			_list_index_clear(sl->index);
+		}
+		sl->length = 0;
+		_list_maybe_shrink(sl);
+	} else {
+		listRemoveRange(sl, 0, sl->length);
+	}
+	_list_linearize(sl); // nothing to move, just hand the head room back
+}
+
+// copy the live elements of an arena-backed list into fresh chunks, reclaiming all holes
+StringList *listCompactArena(StringList *sl) {
+	_LIST_TRACE(listCompactArena, sl, sl->length);
+	if (sl->arena == NULL) {
+		return sl; // heap-backed lists have no holes to reclaim
+	}
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	ListArena *fresh = _list_arena_new(&sl->allocator, sl->arena->chunk_size);
+	char **copies = _list_alloc(&sl->allocator, ((sl->length > 0 ? sl->length : 1) * sizeof(char*)));
+	if ((fresh == NULL) || (copies == NULL)) {
+		if (fresh != NULL) {
+			_list_arena_destroy(fresh);
+		}
+		_list_free(&sl->allocator, copies);
+		return NULL;
+	}
+
+	for (int i = 0; i < sl->length; i++) {
+		size_t size = strlen(sl->list[i]) + 1;
+		copies[i] = _list_arena_alloc(fresh, size);
+		if (copies[i] == NULL) {
+			_list_arena_destroy(fresh);
+			_list_free(&sl->allocator, copies);
+			return NULL; // the original arena and slots are untouched
+		}
+		memcpy(copies[i], sl->list[i], size);
+	}
+
+	memcpy(sl->list, copies, (sl->length * sizeof(char*)));
+	_list_free(&sl->allocator, copies);
+	_list_arena_destroy(sl->arena);
+	sl->arena = fresh;
+	if (sl->borrowed != NULL) {
+		_list_borrow_end(sl); // every string now has a copy in the fresh arena
+	}
+	return sl;
+}
+
+/**
+	sorting: both sorts only permute the pointers in 'sl->list', element strings are never copied.
+	listSort is a stable merge sort for arbitrary orderings; listSortLexicographic is a multikey
+	quicksort specialised for byte-wise order that never re-reads the prefix it has already matched.
+**/
+
+#define LIST_SORT_CUTOFF 16 // below this many elements, insertion sort wins
+
+void _list_insertion_sort(char **slots, const int n, int (*comparator_funct)(const char *, const char *)) {
+	for (int i = 1; i < n; i++) {
+		char *value = slots[i];
+		int j = i;
+		while ((j > 0) && (comparator_funct(slots[(j - 1)], value) > 0)) { // strictly greater keeps it stable
+			slots[j] = slots[(j - 1)];
+			j--;
+		}
+		slots[j] = value;
+	}
+}
+
+// stable merge of the sorted runs a[0, n_a) and b[0, n_b) into 'out'
+void _list_merge(char **a, const int n_a, char **b, const int n_b, char **out, int (*comparator_funct)(const char *, const char *)) {
+	int i = 0;
+	int j = 0;
+	int o = 0;
+	while ((i < n_a) && (j < n_b)) {
+		// take from 'a' on ties so equal elements keep their original order
+		if (comparator_funct(b[j], a[i]) < 0) {
+			out[o++] = b[j++];
+		} else {
+			out[o++] = a[i++];
+		}
+	}
+	memcpy(&out[o], &a[i], ((n_a - i) * sizeof(char*)));
+	o += (n_a - i);
+	memcpy(&out[o], &b[j], ((n_b - j) * sizeof(char*)));
+}
+
+// bottom-up stable merge sort of slots[0, n) using 'scratch' (room for n pointers)
+void _list_merge_sort(char **slots, const int n, char **scratch, int (*comparator_funct)(const char *, const char *)) {
+	for (int start = 0; start < n; start += LIST_SORT_CUTOFF) {
+		int run = ((n - start) < LIST_SORT_CUTOFF) ? (n - start) : LIST_SORT_CUTOFF;
+		_list_insertion_sort(&slots[start], run, comparator_funct);
+	}
+
+	char **from = slots;
+	char **to = scratch;
+	for (int width = LIST_SORT_CUTOFF; width < n; width *= 2) {
+		for (int start = 0; start < n; start += (2 * width)) {
+			int mid = ((start + width) < n) ? (start + width) : n;
+			int end = ((start + (2 * width)) < n) ? (start + (2 * width)) : n;
+			_list_merge(&from[start], (mid - start), &from[mid], (end - mid), &to[start], comparator_funct);
+		}
+		char **swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != slots) { // an odd number of passes left the result in the scratch buffer
+		memcpy(slots, from, (n * sizeof(char*)));
+	}
+}
+
+StringList *listSort(StringList *sl, int (*comparator_funct)(const char *, const char *)) {
+	_LIST_TRACE(listSort, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	if (sl->length < 2) {
+		sl->sorted_by = comparator_funct;
+		return sl;
+	}
+
+	char **scratch = _list_alloc(&sl->allocator, (sl->length * sizeof(char*)));
+	if (scratch == NULL) {
+		return NULL;
+	}
+
+	_list_merge_sort(sl->list, sl->length, scratch, comparator_funct);
+	_list_free(&sl->allocator, scratch);
+
+	_list_meta_refresh(sl);
+	_list_index_shifted(sl);
+	_list_index_settle(sl);
+	sl->sorted_by = comparator_funct;
+	return sl;
+}
+
+// insertion sort of strings already known to share their first 'depth' bytes
+void _list_insertion_sort_from(char **slots, const int n, const size_t depth) {
+	for (int i = 1; i < n; i++) {
+		char *value = slots[i];
+		int j = i;
+		while ((j > 0) && (strcmp((slots[(j - 1)] + depth), (value + depth)) > 0)) {
+			slots[j] = slots[(j - 1)];
+			j--;
+		}
+		slots[j] = value;
+	}
+}
+
+// byte of 'value' at 'depth' as an unsigned value, the terminator sorts first
+#define _LIST_BYTE(value, depth) ((unsigned char) (value)[(depth)])
+
+// multikey (three-way radix) quicksort of slots[0, n), all of which share their first 'depth' bytes
+void _list_multikey_sort(char **slots, int n, size_t depth) {
+	while (n > 1) {
+		if (n < LIST_SORT_CUTOFF) {
+			_list_insertion_sort_from(slots, n, depth);
+			return;
+		}
+
+		// median of three bytes as the pivot
+		int a = _LIST_BYTE(slots[0], depth);
+		int b = _LIST_BYTE(slots[(n / 2)], depth);
+		int c = _LIST_BYTE(slots[(n - 1)], depth);
+		int pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a)) : ((a < c) ? a : ((b < c) ? c : b));
+
+		// partition into [less | equal | greater] on the byte at 'depth'
+		int lt = 0;
+		int i = 0;
+		int gt = (n - 1);
+		while (i <= gt) {
+			int byte = _LIST_BYTE(slots[i], depth);
+			char *swap = slots[i];
+			if (byte < pivot) {
+				slots[i++] = slots[lt];
+				slots[lt++] = swap;
+			} else if (byte > pivot) {
+				slots[i] = slots[gt];
+				slots[gt--] = swap;
+			} else {
+				i++;
+			}
+		}
+
+		_list_multikey_sort(slots, lt, depth);
+		_list_multikey_sort(&slots[(gt + 1)], (n - gt - 1), depth);
+
+		if (pivot == 0) {
+			return; // the equal partition holds identical, fully compared strings
+		}
+
+		// the equal partition shares one more byte, continue on it without recursing
+		slots = &slots[lt];
+		n = (gt - lt + 1);
+		depth++;
+	}
+}
+
+#define LIST_RADIX_CUTOFF 4096 // below this many elements, multikey quicksort wins
+
+/*
+	cache-aware MSD radix sort: the byte at 'depth' of every string is read once into the
+	sequential 'oracle' array, and the bucket counting and distribution passes then work on that
+	array instead of chasing each string pointer again. 'scratch' and 'oracle' hold room for n.
+	only the smaller buckets recurse, the largest one continues in the loop, so the stack stays
+	within log2(n) frames even when every string shares a long prefix.
+*/
+void _list_radix_sort(char **slots, int n, size_t depth, char **scratch, unsigned char *oracle) {
+	while (n >= LIST_RADIX_CUTOFF) {
+		int counts[256] = { 0 };
+		for (int i = 0; i < n; i++) {
+			oracle[i] = _LIST_BYTE(slots[i], depth);
+			counts[oracle[i]]++;
+		}
+
+		int largest = 1;
+		int offsets[256];
+		int offset = 0;
+		for (int b = 0; b < 256; b++) {
+			offsets[b] = offset;
+			offset += counts[b];
+			if ((b > 0) && (counts[b] > counts[largest])) {
+				largest = b;
+			}
+		}
+		if (counts[largest] == n) {
+			depth++; // every string has the same byte here, nothing to distribute
+			continue;
+		}
+
+		for (int i = 0; i < n; i++) {
+			scratch[offsets[oracle[i]]++] = slots[i];
+		}
+		memcpy(slots, scratch, (n * sizeof(char*)));
+
+		// bucket 0 holds strings that ended at 'depth', they are all equal and already in place
+		int start = counts[0];
+		for (int b = 1; b < 256; b++) {
+			if ((b != largest) && (counts[b] > 1)) {
+				_list_radix_sort(&slots[start], counts[b], (depth + 1), scratch, oracle);
+			}
+			start += counts[b];
+		}
+
+		slots = &slots[(offsets[largest] - counts[largest])]; // the distribution pass moved each offset to its bucket's end
+		n = counts[largest];
+		depth++;
+	}
+	_list_multikey_sort(slots, n, depth);
+}
+
+StringList *listSortLexicographic(StringList *sl) {
+	_LIST_TRACE(listSortLexicographic, sl, sl->length);
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	if (sl->length >= LIST_RADIX_CUTOFF) {
+		char **scratch = _list_alloc(&sl->allocator, (sl->length * sizeof(char*)));
+		unsigned char *oracle = _list_alloc(&sl->allocator, (sl->length));
+		if ((scratch == NULL) || (oracle == NULL)) {
+			_list_free(&sl->allocator, scratch);
+			_list_free(&sl->allocator, oracle);
+			_list_multikey_sort(sl->list, sl->length, 0); // still correct, just without the cache
+		} else {
+			_list_radix_sort(sl->list, sl->length, 0, scratch, oracle);
+			_list_free(&sl->allocator, scratch);
+			_list_free(&sl->allocator, oracle);
+		}
+	} else {
+		_list_multikey_sort(sl->list, sl->length, 0);
+	}
+
+	_list_meta_refresh(sl);
+	_list_index_shifted(sl);
+	_list_index_settle(sl);
+	sl->sorted_by = &strcmp; // byte-wise order is exactly strcmp order
+	return sl;
+}
+
+
+/**
+	thread pool: workers are started on first use and kept for the life of the process, so
+	parallel operations pay for a wake-up rather than a pthread_create per call. there are never
+	more workers than processors besides the caller, however many threads a call asks for; extra
+	tasks are claimed by whichever thread is free. one job runs at a time; the calling thread
+	always works on its own job too, so a job completes even when no worker could be started.
+**/
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	int workers;
+	int max_workers; // processors besides the caller's, -1 until the first job
+
+	// the job in flight
+	bool busy;
+	void *(*task)(void *);
+	char *args;
+	size_t arg_size;
+	int count;
+	int next; // next task index to hand out
+	int pending; // tasks handed out or waiting that have not finished
+} _ListPool;
+
+_ListPool _list_pool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, -1,
+	false, NULL, NULL, 0, 0, 0, 0
+};
+
+// processors available to the process, at least 1
+int _list_processor_count(void) {
+#ifndef _WIN32
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	const char *variable = getenv("NUMBER_OF_PROCESSORS");
+	long processors = (variable != NULL) ? strtol(variable, NULL, 10) : 1;
+#endif
+	return ((processors > 0) && (processors <= INT_MAX)) ? (int) processors : 1;
+}
+
+// run tasks of the current job until none are left to claim, called with the pool lock held
+void _list_pool_drain(_ListPool *pool) {
+	while (pool->busy && (pool->next < pool->count)) {
+		int i = pool->next++;
+		void *(*task)(void *) = pool->task;
+		void *arg = (pool->args + (i * pool->arg_size));
+
+		pthread_mutex_unlock(&pool->lock);
+		task(arg);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->pending == 0) {
+			pthread_cond_broadcast(&pool->work_done);
+		}
+	}
+}
+
+void *_list_pool_worker(void *arg) {
+	_ListPool *pool = arg;
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (!pool->busy || (pool->next >= pool->count)) {
+			pthread_cond_wait(&pool->work_ready, &pool->lock);
+		}
+		_list_pool_drain(pool);
+	}
+	return NULL;
+}
+
+// run task(args + i * arg_size) for i in [0, count) on up to 'count' threads (fewer with fewer processors), and wait for all of them
+void _list_parallel_run(const int count, void *(*task)(void *), void *args, const size_t arg_size) {
+	_ListPool *pool = &_list_pool;
+	pthread_mutex_lock(&pool->lock);
+
+	// the caller is one of the threads, start workers for the rest
+	if (pool->max_workers < 0) {
+		pool->max_workers = _list_processor_count() - 1;
+	}
+	int wanted = ((count - 1) < pool->max_workers) ? (count - 1) : pool->max_workers;
+	while (pool->workers < wanted) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, &_list_pool_worker, pool) != 0) {
+			break; // run with the workers we have
+		}
+		pthread_detach(thread);
+		pool->workers++;
+	}
+
+	while (pool->busy) { // another caller's job is in flight
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	}
+
+	pool->busy = true;
+	pool->task = task;
+	pool->args = args;
+	pool->arg_size = arg_size;
+	pool->count = count;
+	pool->next = 0;
+	pool->pending = count;
+	pthread_cond_broadcast(&pool->work_ready);
+
+	_list_pool_drain(pool);
+	while (pool->pending > 0) {
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	}
+
+	pool->busy = false;
+	pthread_cond_broadcast(&pool->work_done); // wake callers waiting for their turn
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+/**
+	parallel sort: the slots are cut into one chunk per thread and each chunk is merge sorted
+	concurrently, then the sorted runs are merged pairwise in rounds. every round splits its
+	whole output evenly across all threads by co-ranking ("merge path"), so the last merges
+	are just as parallel as the first. ties always go to the left run, which keeps the result
+	stable and therefore identical to listSort.
+**/
+
+/*
+	co-rank: how many of the first k merged elements come from 'a'.
+	finds the smallest i such that the merge takes a[0, i) and b[0, k - i), with ties going to 'a'.
+*/
+int _list_co_rank(const int k, char **a, const int n_a, char **b, const int n_b, int (*comparator_funct)(const char *, const char *)) {
+	int lo = (k > n_b) ? (k - n_b) : 0;
+	int hi = (k < n_a) ? k : n_a;
+	while (lo < hi) {
+		int i = lo + ((hi - lo) / 2);
+		int j = k - i;
+		// a[i] precedes b[j - 1] (ties included), so more of 'a' belongs in the prefix
+		if ((j > 0) && (comparator_funct(b[(j - 1)], a[i]) >= 0)) {
+			lo = i + 1;
+		} else {
+			hi = i;
+		}
+	}
+	return lo;
+}
+
+typedef struct {
+	char **from; // the current runs
+	char **to; // where this round writes its output
+	char **scratch; // only used by the chunk sorting phase
+	const int *bounds; // run i spans [bounds[i], bounds[i + 1])
+	int runs;
+	int out_from; // this task's share of the output, [out_from, out_to)
+	int out_to;
+	int (*comparator_funct)(const char *, const char *);
+} _ListSortTask;
+
+void *_list_sort_chunk_task(void *arg) {
+	_ListSortTask *task = arg;
+	int n = task->out_to - task->out_from;
+	_list_merge_sort(&task->from[task->out_from], n, &task->scratch[task->out_from], task->comparator_funct);
+	return NULL;
+}
+
+void *_list_merge_round_task(void *arg) {
+	_ListSortTask *task = arg;
+	for (int r = 0; r < task->runs; r += 2) {
+		int start = task->bounds[r];
+		int mid = task->bounds[(r + 1)];
+		int end = ((r + 2) <= task->runs) ? task->bounds[(r + 2)] : mid; // an odd last run has no partner
+
+		// the part of this pair's output that falls into this task's share
+		int lo = (task->out_from > start) ? task->out_from : start;
+		int hi = (task->out_to < end) ? task->out_to : end;
+		if (lo >= hi) {
+			continue;
+		}
+
+		char **a = &task->from[start];
+		char **b = &task->from[mid];
+		int n_a = mid - start;
+		int n_b = end - mid;
+		int i_lo = _list_co_rank((lo - start), a, n_a, b, n_b, task->comparator_funct);
+		int i_hi = _list_co_rank((hi - start), a, n_a, b, n_b, task->comparator_funct);
+		int j_lo = (lo - start) - i_lo;
+		int j_hi = (hi - start) - i_hi;
+
+		_list_merge(&a[i_lo], (i_hi - i_lo), &b[j_lo], (j_hi - j_lo), &task->to[lo], task->comparator_funct);
+	}
+	return NULL;
+}
+
+StringList *listSortParallel(StringList *sl, int (*comparator_funct)(const char *, const char *), const int nthreads) {
+	_LIST_TRACE(listSortParallel, sl, sl->length);
+	assert(nthreads > 0);
+
+	int n = sl->length;
+	int threads = (nthreads < (n / LIST_SORT_CUTOFF)) ? nthreads : (n / LIST_SORT_CUTOFF);
+	if (threads < 2) {
+		return listSort(sl, comparator_funct); // not enough work to share
+	}
+	if (!_list_unshare(sl)) {
+		return NULL;
+	}
+
+	char **scratch = _list_alloc(&sl->allocator, (n * sizeof(char*)));
+	int *bounds = _list_alloc(&sl->allocator, ((threads + 1) * sizeof(int)));
+	_ListSortTask *tasks = _list_alloc(&sl->allocator, (threads * sizeof(_ListSortTask)));
+	if ((scratch == NULL) || (bounds == NULL) || (tasks == NULL)) {
+		_list_free(&sl->allocator, scratch);
+		_list_free(&sl->allocator, bounds);
+		_list_free(&sl->allocator, tasks);
+		return NULL;
+	}
+
+	for (int t = 0; t <= threads; t++) {
+		bounds[t] = (int) (((long long) n * t) / threads);
+	}
+
+	// phase one: sort one chunk per thread
+	for (int t = 0; t < threads; t++) {
+		tasks[t] = (_ListSortTask) {
+			sl->list, NULL, scratch, NULL, 0, bounds[t], bounds[(t + 1)], comparator_funct
+		};
+	}
+	_list_parallel_run(threads, &_list_sort_chunk_task, tasks, sizeof(_ListSortTask));
+
+	// phase two: merge runs pairwise, ping-ponging between the slots and the scratch buffer
+	char **from = sl->list;
+	char **to = scratch;
+	int runs = threads;
+	while (runs > 1) {
+		for (int t = 0; t < threads; t++) {
+			tasks[t] = (_ListSortTask) {
+				from, to, NULL, bounds, runs, (int) (((long long) n * t) / threads),
+				(int) (((long long) n * (t + 1)) / threads), comparator_funct
+			};
+		}
+		_list_parallel_run(threads, &_list_merge_round_task, tasks, sizeof(_ListSortTask));
+
+		// the merged pairs become the runs of the next round
+		int merged = 0;
+		for (int r = 0; r < runs; r += 2) {
+			bounds[merged++] = bounds[r];
+		}
+		bounds[merged] = n;
+		runs = merged;
+
+		char **swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != sl->list) {
+		memcpy(sl->list, from, (n * sizeof(char*)));
+	}
+
+	_list_free(&sl->allocator, scratch);
+	_list_free(&sl->allocator, bounds);
+	_list_free(&sl->allocator, tasks);
+
+	_list_meta_refresh(sl);
+	_list_index_shifted(sl);
+	_list_index_settle(sl);
+	sl->sorted_by = comparator_funct;
+	return sl;
+}
+
+
+/**
+	sorted mode: a sort (or listNewSorted) records the comparator in 'sl->sorted_by', and it is
+	cleared by any write that could break the order. removals keep it. while it is set, lookups
+	can binary search, and lists sorted byte-wise answer listIndexOf in O(log n) compares.
+**/
+
+// first index whose element does not order before 'element'
+int listLowerBound(const StringList *sl, const char *element) {
+	_LIST_TRACE(listLowerBound, sl, sl->length);
+	assert(sl->sorted_by != NULL); // the list must be in a known order
+
+	int lo = 0;
+	int hi = sl->length;
+	while (lo < hi) {
+		int mid = lo + ((hi - lo) / 2);
+		_LIST_COUNT(sl, compares, 1);
+		if (sl->sorted_by(sl->list[mid], element) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// first index whose element orders after 'element'
+int listUpperBound(const StringList *sl, const char *element) {
+	_LIST_TRACE(listUpperBound, sl, sl->length);
+	assert(sl->sorted_by != NULL); // the list must be in a known order
+
+	int lo = 0;
+	int hi = sl->length;
+	while (lo < hi) {
+		int mid = lo + ((hi - lo) / 2);
+		_LIST_COUNT(sl, compares, 1);
+		if (sl->sorted_by(sl->list[mid], element) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// index of the first element that compares equal to 'element', or -1
+int listBinarySearch(const StringList *sl, const char *element) {
+	_LIST_TRACE(listBinarySearch, sl, sl->length);
+	int index = listLowerBound(sl, element);
+	if ((index < sl->length) && (sl->sorted_by(sl->list[index], element) == 0)) {
+		return index;
+	}
+	return -1;
+}
+
+// insert a copy of 'value' after every element that does not order after it, keeping the list sorted
+StringList *listSortedInsert(StringList *sl, const char *value) {
+	_LIST_TRACE(listSortedInsert, sl, sl->length);
+	int (*comparator_funct)(const char *, const char *) = sl->sorted_by;
+	int index = listUpperBound(sl, value);
+
+	StringList *result = (index == sl->length) ? listAdd(sl, value) : listInsert(sl, index, value);
+	sl->sorted_by = comparator_funct; // the value went exactly where the order wants it
+	return result;
+}
+
+
+/**
+	parallel scans: the slots are cut into one contiguous chunk per thread and each chunk is
+	handled by the thread pool. lists below LIST_PARALLEL_MIN elements take the serial path.
+	predicates are called from several threads at once and must be safe to call concurrently.
+**/
+
+#define LIST_PARALLEL_MIN 65536
+
+typedef struct {
+	const StringList *sl;
+	const StringList *other; // the second list of listParallelEquals
+	const char *element;
+	bool (*conditional_funct)(const char *);
+	atomic_bool *stop; // set once any chunk has decided the answer
+	int from;
+	int to;
+	int result; // first match, match count, or survivors, depending on the operation
+	bool release; // listParallelRemoveIf: free dropped strings in the worker
+} _ListScanTask;
+
+// number of chunks to use for 'n' elements, 1 means take the serial path
+int _list_parallel_chunks(const int n, const int nthreads) {
+	if ((nthreads < 2) || (n < LIST_PARALLEL_MIN)) {
+		return 1;
+	}
+	int most = n / (LIST_PARALLEL_MIN / 4); // keep every chunk worth a wake-up
+	return (nthreads < most) ? nthreads : most;
+}
+
+// set up one task per chunk of [0, n) in 'tasks'
+void _list_parallel_split(_ListScanTask *tasks, const int chunks, const int n, const _ListScanTask *prototype) {
+	for (int t = 0; t < chunks; t++) {
+		tasks[t] = *prototype;
+		tasks[t].from = (int) (((long long) n * t) / chunks);
+		tasks[t].to = (int) (((long long) n * (t + 1)) / chunks);
+		tasks[t].result = 0;
+	}
+}
+
+void *_list_index_of_task(void *arg) {
+	_ListScanTask *task = arg;
+	task->result = _list_scan(task->sl, task->from, task->to, task->element, false);
+	return NULL;
+}
+
+int listParallelIndexOf(const StringList *sl, const char *element, const int nthreads) {
+	_LIST_TRACE(listParallelIndexOf, sl, sl->length);
+	int chunks = _list_parallel_chunks(sl->length, nthreads);
+	if ((chunks < 2) || (sl->index != NULL) || (sl->sorted_by == &strcmp)) {
+		return listIndexOf(sl, element); // small, or already answered without a scan
+	}
+
+	_ListScanTask *tasks = _list_alloc(&sl->allocator, (chunks * sizeof(_ListScanTask)));
+	if (tasks == NULL) {
+		return listIndexOf(sl, element);
+	}
+
+	_ListScanTask prototype = { sl, NULL, element, NULL, NULL, 0, 0, 0, false };
+	_list_parallel_split(tasks, chunks, sl->length, &prototype);
+	_list_parallel_run(chunks, &_list_index_of_task, tasks, sizeof(_ListScanTask));
+
+	int result = -1;
+	for (int t = 0; (t < chunks) && (result == -1); t++) {
+		result = tasks[t].result; // the earliest chunk with a match holds the first occurrence
+	}
+
+	_list_free(&sl->allocator, tasks);
+	return result;
+}
+
+void *_list_count_task(void *arg) {
+	_ListScanTask *task = arg;
+	for (int i = task->from; i < task->to; i++) {
+		task->result += task->conditional_funct(task->sl->list[i]);
+	}
+	return NULL;
+}
+
+int listParallelCount(const StringList *sl, bool (*conditional_funct)(const char *), const int nthreads) {
+	_LIST_TRACE(listParallelCount, sl, sl->length);
+	int chunks = _list_parallel_chunks(sl->length, nthreads);
+	_ListScanTask *tasks = _list_alloc(&sl->allocator, (chunks * sizeof(_ListScanTask)));
+	_ListScanTask serial;
+	if (tasks == NULL) {
+		tasks = &serial;
+		chunks = 1;
+	}
+
+	_ListScanTask prototype = { sl, NULL, NULL, conditional_funct, NULL, 0, 0, 0, false };
+	_list_parallel_split(tasks, chunks, sl->length, &prototype);
+	if (chunks > 1) {
+		_list_parallel_run(chunks, &_list_count_task, tasks, sizeof(_ListScanTask));
+	} else {
+		_list_count_task(tasks);
+	}
+
+	int result = 0;
+	for (int t = 0; t < chunks; t++) {
+		result += tasks[t].result;
+	}
+
+	if (tasks != &serial) {
+		_list_free(&sl->allocator, tasks);
+	}
+	return result;
+}
+
+void *_list_equals_task(void *arg) {
+	_ListScanTask *task = arg;
+	const StringList *sl_a = task->sl;
+	const StringList *sl_b = task->other;
+	bool tagged = ((sl_a->hashes != NULL) && (sl_b->hashes != NULL));
+
+	task->result = 1;
+	for (int i = task->from; i < task->to; i++) {
+		if (((i & 1023) == 0) && atomic_load_explicit(task->stop, memory_order_relaxed)) {
+			return NULL; // another chunk already found a mismatch
+		}
+
+		bool equal = tagged
+			? _list_element_equals(sl_a, i, sl_b->list[i], sl_b->hashes[i], sl_b->lengths[i])
+			: (strcmp(sl_a->list[i], sl_b->list[i]) == 0);
+		if (!equal) {
+			task->result = 0;
+			atomic_store_explicit(task->stop, true, memory_order_relaxed);
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+bool listParallelEquals(const StringList *sl_a, const StringList *sl_b, const int nthreads) {
+	_LIST_TRACE(listParallelEquals, sl_a, sl_a->length);
+	if (sl_a->length != sl_b->length) {
+		return false;
+	}
+
+	int chunks = _list_parallel_chunks(sl_a->length, nthreads);
+	_ListScanTask *tasks = (chunks > 1) ? _list_alloc(&sl_a->allocator, (chunks * sizeof(_ListScanTask))) : NULL;
+	if (tasks == NULL) {
+		return listEquals(sl_a, sl_b);
+	}
+
+	atomic_bool stop = false;
+	_ListScanTask prototype = { sl_a, sl_b, NULL, NULL, &stop, 0, 0, 0, false };
+	_list_parallel_split(tasks, chunks, sl_a->length, &prototype);
+	_list_parallel_run(chunks, &_list_equals_task, tasks, sizeof(_ListScanTask));
+
+	_list_free(&sl_a->allocator, tasks);
+	return !atomic_load(&stop);
+}
+
+// swap two slots together with their metadata
+void _list_swap_slots(StringList *sl, const int a, const int b) {
+	char *value = sl->list[a];
+	sl->list[a] = sl->list[b];
+	sl->list[b] = value;
+	if (sl->hashes != NULL) {
+		uint32_t hash = sl->hashes[a];
+		sl->hashes[a] = sl->hashes[b];
+		sl->hashes[b] = hash;
+		uint32_t length = sl->lengths[a];
+		sl->lengths[a] = sl->lengths[b];
+		sl->lengths[b] = length;
+	}
+}
+
+/*
+	stable in-chunk partition: survivors are packed, in order, at the front of the chunk and
+	the dropped pointers collect behind them. result is the number of survivors.
+*/
+void *_list_remove_if_task(void *arg) {
+	_ListScanTask *task = arg;
+	StringList *sl = (StringList *) task->sl;
+
+	int kept = task->from;
+	for (int i = task->from; i < task->to; i++) {
+		if (!task->conditional_funct(sl->list[i])) {
+			if (kept != i) {
+				_list_swap_slots(sl, kept, i); // the slot at 'kept' holds a dropped pointer
+			}
+			kept++;
+		}
+	}
+
+	if (task->release) {
+		for (int i = kept; i < task->to; i++) {
+			_list_free(&sl->allocator, sl->list[i]);
+		}
+	}
+
+	task->result = kept - task->from;
+	return NULL;
+}
+
+void listParallelRemoveIf(StringList *sl, bool (*conditional_funct)(const char *), const int nthreads) {
+	_LIST_TRACE(listParallelRemoveIf, sl, sl->length);
+	int chunks = _list_parallel_chunks(sl->length, nthreads);
+	_ListScanTask *tasks = (chunks > 1) ? _list_alloc(&sl->allocator, (chunks * sizeof(_ListScanTask))) : NULL;
+	if (tasks == NULL) {
+		listRemoveIf(sl, conditional_funct);
+		return;
+	}
+	if (!_list_unshare(sl)) {
+		_list_free(&sl->allocator, tasks);
+		return;
+	}
+
+	// malloc'd strings of an unindexed list can be freed by the workers, other storage and borrowed strings are not theirs to free
+	bool release = ((sl->arena == NULL) && (sl->cells == NULL) && (sl->index == NULL) && (sl->borrowed == NULL) &&
+		_list_same_allocator(&sl->allocator, &_list_std_allocator));
+
+	_ListScanTask prototype = { sl, NULL, NULL, conditional_funct, NULL, 0, 0, 0, release };
+	_list_parallel_split(tasks, chunks, sl->length, &prototype);
+	_list_parallel_run(chunks, &_list_remove_if_task, tasks, sizeof(_ListScanTask));
+
+	if (!release) {
+		for (int t = 0; t < chunks; t++) {
+			for (int i = (tasks[t].from + tasks[t].result); i < tasks[t].to; i++) {
+				_list_drop_element(sl, i);
+			}
+		}
+	}
+
+	// prefix sum of survivor counts: each chunk's survivors move down to where the previous chunk's end
+	int kept = 0;
+	for (int t = 0; t < chunks; t++) {
+		if (kept != tasks[t].from) {
+			_list_move_slots(sl, kept, tasks[t].from, tasks[t].result);
+		}
+		kept += tasks[t].result;
+	}
+
+	if (kept != sl->length) {
+		_list_index_shifted(sl);
+	}
+	sl->length = kept;
+	_list_index_settle(sl);
+	_list_maybe_shrink(sl);
+	_list_free(&sl->allocator, tasks);
+}
+
+
+/**
+	saved lists: listSave writes a header, a table of string offsets, the element hashes and
+	lengths, then every string back to back with its terminator, all in native byte order.
+	listOpenMapped maps such a file read-only and points a list's slots into it, so opening
+	allocates only the slot array and the strings and metadata are paged in as they are read.
+	a mapped list is modified like a shared one: the first write copies it to the heap.
+	windows builds have no mmap, there the file is read into one heap buffer instead.
+**/
+
+#define LIST_FILE_VERSION 1
+
+typedef struct {
+	char magic[4]; // "SLST"
+	uint32_t version; // also rejects files written with the other byte order
+	uint32_t count;
+	uint32_t padding;
+	uint64_t blob_bytes; // size of the string section at the end of the file
+} _ListFileHeader;
+
+struct _ListMapping {
+	ListAllocator allocator;
+	void *address;
+	size_t size;
+};
+
+// the 'size' bytes of the file at 'path' in read-only memory, NULL if it could not be opened or is empty
+char *_list_mapping_open(const char *path, size_t *size) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	struct stat info;
+	if ((fstat(fd, &info) != 0) || (info.st_size <= 0)) {
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t) info.st_size;
+	char *address = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file open
+	return (address == MAP_FAILED) ? NULL : address;
+#else
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	struct stat info;
+	char *address = NULL;
+	if ((fstat(fileno(file), &info) == 0) && (info.st_size > 0)) {
+		*size = (size_t) info.st_size;
+		address = malloc(*size);
+		if ((address != NULL) && (fread(address, 1, *size, file) != *size)) {
+			free(address);
+			address = NULL;
+		}
+	}
+	fclose(file);
+	return address;
+#endif
+}
+
+void _list_mapping_close(char *address, const size_t size) {
+#ifndef _WIN32
+	munmap(address, size);
+#else
+	free(address);
+#endif
+}
+
+void _list_mapping_release(ListMapping *mapping) {
+	_list_mapping_close(mapping->address, mapping->size);
+	ListAllocator allocator = mapping->allocator;
+	_list_free(&allocator, mapping);
+}
+
+size_t _list_mapping_size(const ListMapping *mapping) {
+	return mapping->size;
+}
+
+// write 'sl' to 'path' in the format listOpenMapped() reads, false (leaving no file) if it could not be written
+bool listSave(const StringList *sl, const char *path) {
+	_LIST_TRACE(listSave, sl, sl->length);
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	_ListFileHeader header = { { 'S', 'L', 'S', 'T' }, LIST_FILE_VERSION, (uint32_t) sl->length, 0, 0 };
+	for (int i = 0; i < sl->length; i++) {
+		header.blob_bytes += strlen(sl->list[i]) + 1;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+
+	uint64_t offset = 0;
+	for (int i = 0; i < sl->length; i++) {
+		fwrite(&offset, sizeof(offset), 1, file);
+		offset += strlen(sl->list[i]) + 1;
+	}
+	for (int pass = 0; pass < 2; pass++) { // every hash, then every length
+		for (int i = 0; i < sl->length; i++) {
+			size_t length;
+			uint32_t hash = _list_hash_length(sl->list[i], &length);
+			uint32_t value = (pass == 0) ? hash : ((length < LIST_LENGTH_CLAMP) ? (uint32_t) length : LIST_LENGTH_CLAMP);
+			fwrite(&value, sizeof(value), 1, file);
+		}
+	}
+	for (int i = 0; i < sl->length; i++) {
+		fwrite(sl->list[i], 1, (strlen(sl->list[i]) + 1), file);
+	}
+
+	bool written = !ferror(file);
+	written = (fclose(file) == 0) && written;
+	if (!written) {
+		remove(path);
+	}
+	return written;
+}
+
+// a read-only view of a file written by listSave(), NULL if it could not be mapped or is not such a file
+StringList *listOpenMapped(const char *path) {
+	_LIST_TRACE(listOpenMapped, NULL, 0);
+	size_t size;
+	char *address = _list_mapping_open(path, &size);
+	if (address == NULL) {
+		return NULL;
+	}
+	if (size < sizeof(_ListFileHeader)) {
+		_list_mapping_close(address, size);
+		return NULL;
+	}
+
+	const _ListFileHeader *header = (const _ListFileHeader *) address;
+	uint64_t tables = sizeof(_ListFileHeader) + ((uint64_t) header->count * (sizeof(uint64_t) + (2 * sizeof(uint32_t))));
+	const char *blob = address + tables;
+	if ((memcmp(header->magic, "SLST", 4) != 0) || (header->version != LIST_FILE_VERSION) || (header->count > INT_MAX) ||
+		(header->blob_bytes > size) || ((tables + header->blob_bytes) != size) ||
+		((header->blob_bytes > 0) && (blob[(header->blob_bytes - 1)] != '\0'))) { // so every string ends inside the file
+		_list_mapping_close(address, size);
+		return NULL;
+	}
+
+	int count = (int) header->count;
+	StringList *result = listNewCapacity((count > 0) ? count : 1);
+	ListMapping *mapping = (result != NULL) ? _list_alloc(&result->allocator, sizeof(ListMapping)) : NULL;
+	if (mapping == NULL) {
+		if (result != NULL) {
+			listDestroy(result);
+		}
+		_list_mapping_close(address, size);
+		return NULL;
+	}
+
+	const uint64_t *offsets = (const uint64_t *) (address + sizeof(_ListFileHeader));
+	const uint32_t *lengths = (const uint32_t *) &offsets[count] + count;
+	for (int i = 0; i < count; i++) {
+		// the stored length must put the terminator inside the file, where a clamped length can't say exactly
+		if ((offsets[i] >= header->blob_bytes) || ((offsets[i] + lengths[i]) >= header->blob_bytes) ||
+			((lengths[i] != LIST_LENGTH_CLAMP) && (blob[(offsets[i] + lengths[i])] != '\0'))) {
+			_list_free(&result->allocator, mapping);
+			listDestroy(result);
+			_list_mapping_close(address, size);
+			return NULL;
+		}
+		result->list[i] = (char *) (blob + offsets[i]); // never written, mapped lists are copied before any change
+	}
+
+	mapping->allocator = result->allocator;
+	mapping->address = address;
+	mapping->size = size;
+	result->mapping = mapping;
+	result->length = count;
+	result->hashes = (uint32_t *) &offsets[count];
+	result->lengths = (uint32_t *) lengths;
+	return result;
+}
+
+
+/**
+	bulk loading: listReadLines reads its input straight into arena chunks and splits it in
+	place, writing a terminator over each delimiter, so every element points into a chunk and
+	the input is held in memory once. when the input is a regular file of known size, one chunk
+	holds all of it and the slot array is reserved once from a count of the delimiters;
+	otherwise it is read in blocks, with a line cut off at the end of a block moved to the next.
+**/
+
+#define LIST_LOAD_BLOCK (1 << 20) // bytes read at a time when the input size is unknown
+
+// a new current chunk of at least 'size' bytes, holding a copy of the unfinished line 'partial' bytes at 'from'
+ListArenaChunk *_list_load_chunk(ListArena *arena, const size_t size, const char *from, const size_t partial) {
+	ListArenaChunk *chunk = _list_arena_chunk_new(arena, ((size > (2 * partial)) ? size : (2 * partial)));
+	if (chunk == NULL) {
+		return NULL;
+	}
+
+	if (partial > 0) { // the first chunk has no line to carry over
+		memcpy(chunk->data, from, partial);
+	}
+	chunk->used = partial;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	return chunk;
+}
+
+// store the line at 'line' as the next element of 'sl', which has room for it
+void _list_load_line(StringList *sl, char *line, char *end, const char delimiter) {
+	if ((delimiter == '\n') && (end > line) && (end[-1] == '\r')) {
+		end[-1] = '\0'; // CRLF line endings
+	}
+	*end = '\0';
+	sl->list[sl->length++] = line;
+}
+
+// read every 'delimiter'-separated element from the current position of 'file' to its end, NULL on a read error or if memory ran out
+StringList *listReadLines(FILE *file, const char delimiter) {
+	_LIST_TRACE(listReadLines, NULL, 0);
+	size_t first_chunk = LIST_LOAD_BLOCK;
+	struct stat info;
+	int fd = fileno(file);
+	off_t position = (fd != -1) ? ftello(file) : -1;
+	if ((position != -1) && (fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size >= position)) {
+		first_chunk = (size_t) (info.st_size - position) + 1; // the whole rest of the file, plus a final terminator
+	}
+
+	StringList *result = listNewArena(1, LIST_LOAD_BLOCK);
+	if (result == NULL) {
+		return NULL;
+	}
+	ListArena *arena = result->arena;
+	ListArenaChunk *chunk = _list_load_chunk(arena, first_chunk, NULL, 0);
+	size_t line = 0; // offset of the unfinished line in 'chunk'
+
+	while (chunk != NULL) {
+		if (chunk->used == chunk->size) {
+			ListArenaChunk *full = chunk;
+			chunk = _list_load_chunk(arena, LIST_LOAD_BLOCK, &full->data[line], (full->used - line));
+			full->used = line;
+			line = 0;
+			if ((chunk != NULL) && (full->used == 0)) { // a single line filled it, don't keep two copies
+				chunk->next = full->next;
+				_list_free(&arena->allocator, full);
+			}
+			continue;
+		}
+
+		size_t read = fread(&chunk->data[chunk->used], 1, (chunk->size - chunk->used), file);
+		if (read == 0) {
+			break;
+		}
+
+		char *from = &chunk->data[chunk->used];
+		char *end = from + read;
+		long long count = result->length;
+		for (char *p = from; (p = memchr(p, delimiter, (end - p))) != NULL; p++) {
+			count++;
+		}
+		if ((count >= INT_MAX) || (_list_reserve(result, (int) (count + 1)) == NULL)) { // one more for a last unterminated line
+			chunk = NULL;
+			break;
+		}
+
+		char *start = &chunk->data[line];
+		for (char *p = from; (p = memchr(p, delimiter, (end - p))) != NULL; p++) {
+			_list_load_line(result, start, p, delimiter);
+			start = (p + 1);
+		}
+		chunk->used += read;
+		line = (start - chunk->data);
+	}
+
+	if ((chunk == NULL) || ferror(file)) {
+		listDestroy(result);
+		return NULL;
+	}
+	if (line < chunk->used) { // the input did not end with a delimiter, the loop left room for its terminator
+		_list_load_line(result, &chunk->data[line], &chunk->data[chunk->used], delimiter);
+		chunk->used++;
+	}
+	return result;
+}
+
+StringList *listLoadLines(const char *path, const char delimiter) {
+	_LIST_TRACE(listLoadLines, NULL, 0);
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+#ifndef _WIN32
+	posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	StringList *result = listReadLines(file, delimiter);
+	fclose(file);
+	return result;
+}
+
+
+/**
+	statistics: a snapshot of where a list's memory goes, plus its operation counters. storage
+	shared with a clone is reported in full by every list that shares it.
+**/
+
+// bytes held by the element strings, and the allocator's bookkeeping around them when it can be measured
+void _list_element_bytes(const StringList *sl, ListStats *stats) {
+	bool measurable = false;
+#if defined(__GLIBC__)
+	measurable = _list_same_allocator(&sl->allocator, &_list_std_allocator);
+#endif
+	stats->overhead_known = measurable && (sl->arena == NULL) && (sl->mapping == NULL);
+
+	if (sl->mapping != NULL) {
+		stats->element_bytes += _list_mapping_size(sl->mapping); // the whole file, tables included
+		return;
+	}
+	if (sl->arena != NULL) {
+		for (ListArenaChunk *chunk = sl->arena->chunks; chunk != NULL; chunk = chunk->next) {
+			stats->element_bytes += sizeof(ListArenaChunk) + chunk->size;
+		}
+		return;
+	}
+
+	if (sl->cells != NULL) {
+		stats->element_bytes += (size_t) sl->cells->count * (LIST_INLINE_CELL + sizeof(int));
+	}
+	for (int i = 0; i < sl->length; i++) {
+		if ((sl->cells != NULL) && (_list_cell_index(sl->cells, sl->list[i]) >= 0)) {
+			continue; // counted with the cells
+		}
+		size_t size = strlen(sl->list[i]) + 1;
+		stats->element_bytes += size;
+#if defined(__GLIBC__)
+		if (measurable && !_list_is_borrowed(sl, sl->list[i])) { // a borrowed string may live in a file, cells or an arena
+			stats->overhead_bytes += malloc_usable_size(sl->list[i]) - size;
+		}
+#endif
+	}
+}
+
+void listStats(const StringList *sl, ListStats *stats) {
+	_LIST_TRACE(listStats, sl, sl->length);
+	memset(stats, 0, sizeof(ListStats));
+
+	int allocated = sl->capacity;
+	stats->length = sl->length;
+	stats->capacity = allocated;
+	stats->slot_bytes = (size_t) allocated * sizeof(char*);
+	if (sl->hashes != NULL) {
+		stats->metadata_bytes = (size_t) allocated * (2 * sizeof(uint32_t));
+	}
+	if (sl->index != NULL) {
+		stats->index_bytes = sizeof(ListIndex) + ((size_t) sl->index->slots * sizeof(ListIndexEntry));
+		for (int i = 0; i < sl->index->slots; i++) {
+			if (sl->index->entries[i].key != NULL) {
+				stats->index_bytes += strlen(sl->index->entries[i].key) + 1;
+			}
+		}
+	}
+	_list_element_bytes(sl, stats);
+
+	stats->slack = (allocated > 0) ? ((double) (allocated - sl->length) / allocated) : 0;
+	stats->shared = _list_is_shared(sl) || (sl->borrowed != NULL);
+	stats->counters = sl->counters;
+}
+
+
+/**
+	histogram collector: listHistogramHook files each call under its duration's power of two,
+	and adds its time to the power of two of its element count. the mean time per size class
+	shows how an operation scales, a quadratic path roughly quadruples with each class.
+**/
+
+// index of the highest set bit of 'value', 0 for 0
+int _list_log2(uint64_t value) {
+	return (value == 0) ? 0 : (63 - __builtin_clzll(value));
+}
+
+void listHistogramHook(const ListOperation operation, const void *list, const int count, const uint64_t nanoseconds, void *histogram) {
+	ListHistogram *h = histogram;
+	int bucket = _list_log2(nanoseconds);
+	if (bucket >= LIST_HISTOGRAM_BUCKETS) {
+		bucket = (LIST_HISTOGRAM_BUCKETS - 1);
+	}
+	int size = _list_log2((count > 0) ? (uint64_t) count : 0);
+
+	// hooks run on every thread that uses a list
+	__atomic_fetch_add(&h->buckets[operation][bucket], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->size_calls[operation][size], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->size_nanoseconds[operation][size], nanoseconds, __ATOMIC_RELAXED);
+}
+
+// upper bound, in nanoseconds, of the bucket holding the given percentile (0-100) of calls, 0 if there were none
+uint64_t listHistogramPercentile(const ListHistogram *h, const ListOperation operation, const double percentile) {
+	assert((percentile >= 0) && (percentile <= 100));
+
+	uint64_t total = 0;
+	for (int b = 0; b < LIST_HISTOGRAM_BUCKETS; b++) {
+		total += h->buckets[operation][b];
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) ((total * percentile) / 100);
+	uint64_t seen = 0;
+	for (int b = 0; b < LIST_HISTOGRAM_BUCKETS; b++) {
+		seen += h->buckets[operation][b];
+		if ((seen > rank) || (seen == total)) {
+			return ((uint64_t) 1 << (b + 1));
+		}
+	}
+	return ((uint64_t) 1 << LIST_HISTOGRAM_BUCKETS);
+}
+
+void listHistogramPrint(const ListHistogram *h) {
+	for (int op = 0; op < LIST_OP_COUNT; op++) {
+		uint64_t calls = 0;
+		for (int b = 0; b < LIST_HISTOGRAM_BUCKETS; b++) {
+			calls += h->buckets[op][b];
+		}
+		if (calls == 0) {
+			continue;
+		}
+
+		printf("%s: %llu calls, p50 < %llu ns, p99 < %llu ns\n", listOperationName(op), (unsigned long long) calls,
+			(unsigned long long) listHistogramPercentile(h, op, 50), (unsigned long long) listHistogramPercentile(h, op, 99));
+		for (int c = 0; c < LIST_HISTOGRAM_SIZES; c++) {
+			if (h->size_calls[op][c] > 0) {
+				printf("  %d+ elements: %llu calls, mean %llu ns\n", ((c == 0) ? 0 : (1 << c)), (unsigned long long) h->size_calls[op][c],
+					(unsigned long long) (h->size_nanoseconds[op][c] / h->size_calls[op][c]));
+			}
+		}
+	}
+}
+
+
+/**
+	output: listJoin measures the joined string first, so it allocates once and copies each
+	element with memcpy. listWrite and listPrint gather their output in one large buffer and
+	hand it to the stream a buffer at a time instead of making a call per element.
+**/
+
+#define LIST_WRITE_BUFFER (256 << 10)
+
+// length of the element at 'index', from the metadata when it is enabled
+size_t _list_element_length(const StringList *sl, const int index) {
+	if ((sl->lengths != NULL) && (sl->lengths[index] != LIST_LENGTH_CLAMP)) {
+		return sl->lengths[index];
+	}
+	return strlen(sl->list[index]);
+}
+
+// every element with 'separator' between each pair, from the allocator of 'sl' (so free() for most lists), NULL if memory ran out
+char *listJoin(const StringList *sl, const char *separator) {
+	_LIST_TRACE(listJoin, sl, sl->length);
+	size_t separator_length = strlen(separator);
+	size_t total = (sl->length > 0) ? ((size_t) (sl->length - 1) * separator_length) : 0;
+	for (int i = 0; i < sl->length; i++) {
+		total += _list_element_length(sl, i);
+	}
+
+	char *result = _list_alloc(&sl->allocator, (total + 1));
+	if (result == NULL) {
+		return NULL;
+	}
+
+	char *end = result;
+	for (int i = 0; i < sl->length; i++) {
+		if (i > 0) {
+			memcpy(end, separator, separator_length);
+			end += separator_length;
+		}
+		size_t length = _list_element_length(sl, i);
+		memcpy(end, sl->list[i], length);
+		end += length;
+	}
+	*end = '\0';
+	return result;
+}
+
+typedef struct {
+	FILE *file;
+	char *buffer;
+	size_t used;
+	bool failed;
+} _ListWriter;
+
+void _list_writer_flush(_ListWriter *writer) {
+	if ((writer->used > 0) && (fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)) {
+		writer->failed = true;
+	}
+	writer->used = 0;
+}
+
+void _list_writer_put(_ListWriter *writer, const char *data, const size_t size) {
+	if ((writer->used + size) > LIST_WRITE_BUFFER) {
+		_list_writer_flush(writer);
+	}
+	if (size > LIST_WRITE_BUFFER) { // too big to gather, it goes out on its own
+		if (fwrite(data, 1, size, writer->file) != size) {
+			writer->failed = true;
+		}
+		return;
+	}
+	memcpy(&writer->buffer[writer->used], data, size);
+	writer->used += size;
+}
+
+// write every element to 'file' with 'separator' between each pair, false if memory ran out or a write failed
+bool listWrite(const StringList *sl, FILE *file, const char *separator) {
+	_LIST_TRACE(listWrite, sl, sl->length);
+	_ListWriter writer = { file, _list_alloc(&sl->allocator, LIST_WRITE_BUFFER), 0, false };
+	if (writer.buffer == NULL) {
+		return false;
+	}
+
+	size_t separator_length = strlen(separator);
+	for (int i = 0; i < sl->length; i++) {
+		if (i > 0) {
+			_list_writer_put(&writer, separator, separator_length);
+		}
+		_list_writer_put(&writer, sl->list[i], _list_element_length(sl, i));
+	}
+	_list_writer_flush(&writer);
+
+	_list_free(&sl->allocator, writer.buffer);
+	return !writer.failed;
+}
+
+void listPrint(const StringList *sl) {
+	_LIST_TRACE(listPrint, sl, sl->length);
+	printf("list (%d/%d) elements: \n", sl->length, sl->capacity);
+
+	_ListWriter writer = { stdout, _list_alloc(&sl->allocator, LIST_WRITE_BUFFER), 0, false };
+	char prefix[32];
+	for (int i = 0; i < sl->length; i++) {
+		if (writer.buffer == NULL) {
+			printf("element[%d] = '%s'\n", i, sl->list[i]); // no memory for the buffer, print as we go
+			continue;
+		}
+		int prefix_length = snprintf(prefix, sizeof(prefix), "element[%d] = '", i);
+		_list_writer_put(&writer, prefix, prefix_length);
+		_list_writer_put(&writer, sl->list[i], _list_element_length(sl, i));
+		_list_writer_put(&writer, "'\n", 2);
+	}
+	if (writer.buffer != NULL) {
+		_list_writer_flush(&writer);
+		_list_free(&sl->allocator, writer.buffer);
+	}
+}
+
+
+/**
+	tiered vector: a separate list type for workloads dominated by inserts and removals in the
+	middle of very large lists. elements live in chunks of 'chunk_size' (a power of two near
+	sqrt(n)) slots, each a circular buffer, with every chunk but the last one full. an insert
+	or removal shifts inside one chunk and then moves a single element across each following
+	chunk boundary, so it costs O(sqrt(n)) instead of O(n); get and set stay O(1).
+**/
+
+#define TIERED_MIN_CHUNK 16
+
+typedef struct {
+	char **slots; // 'chunk_size' entries used as a ring
+	int start; // ring position of the chunk's first element
+	int count;
+} _TieredChunk;
+
+struct _TieredStringList {
+	_TieredChunk *chunks;
+	int chunk_count; // chunks holding elements
+	int chunk_capacity; // chunks allocated in 'chunks'
+	int chunk_size;
+	int chunk_shift; // log2(chunk_size)
+	int length;
+};
+
+#define _TIERED_AT(tl, chunk, offset) ((chunk)->slots[(((chunk)->start + (offset)) & ((tl)->chunk_size - 1))])
+
+TieredStringList *_tiered_new_sized(const int chunk_size) {
+	TieredStringList *tl = malloc(sizeof(TieredStringList));
+	if (tl == NULL) {
+		return NULL;
+	}
+
+	tl->chunks = NULL;
+	tl->chunk_count = 0;
+	tl->chunk_capacity = 0;
+	tl->chunk_size = chunk_size;
+	tl->chunk_shift = 0;
+	while ((1 << tl->chunk_shift) < chunk_size) {
+		tl->chunk_shift++;
+	}
+	tl->length = 0;
+	return tl;
+}
+
+TieredStringList *tieredListNew() {
+	_LIST_TRACE(tieredListNew, NULL, 0);
+	return _tiered_new_sized(TIERED_MIN_CHUNK);
+}
+
+void _tiered_free_chunks(TieredStringList *tl, const bool free_strings) {
+	for (int c = 0; c < tl->chunk_capacity; c++) {
+		_TieredChunk *chunk = &tl->chunks[c];
+		for (int o = 0; (o < chunk->count) && free_strings; o++) {
+			free(_TIERED_AT(tl, chunk, o));
+		}
+		free(chunk->slots);
+	}
+	free(tl->chunks);
+}
+
+void tieredListDestroy(TieredStringList *tl) {
+	_LIST_TRACE(tieredListDestroy, tl, tl->length);
+	_tiered_free_chunks(tl, true);
+	free(tl);
+}
+
+int tieredListLength(const TieredStringList *tl) {
+	_LIST_TRACE(tieredListLength, tl, tl->length);
+	return tl->length;
+}
+
+char *tieredListGet(const TieredStringList *tl, const int index) {
+	_LIST_TRACE(tieredListGet, tl, tl->length);
+	assert(index >= 0);
+	assert(index < tl->length);
+
+	_TieredChunk *chunk = &tl->chunks[(index >> tl->chunk_shift)];
+	return _TIERED_AT(tl, chunk, (index & (tl->chunk_size - 1)));
+}
+
+// make sure one more chunk than is in use is allocated, for the next element past a full last chunk
+bool _tiered_reserve_chunk(TieredStringList *tl) {
+	if (tl->chunk_count < tl->chunk_capacity) {
+		return true;
+	}
+
+	int capacity = (tl->chunk_capacity * 2) + 1;
+	_TieredChunk *chunks = realloc(tl->chunks, (capacity * sizeof(_TieredChunk)));
+	if (chunks == NULL) {
+		return false;
+	}
+	tl->chunks = chunks;
+
+	for (int c = tl->chunk_capacity; c < capacity; c++) {
+		chunks[c].slots = malloc(tl->chunk_size * sizeof(char*));
+		chunks[c].start = 0;
+		chunks[c].count = 0;
+		if (chunks[c].slots == NULL) {
+			tl->chunk_capacity = c; // keep what was allocated
+			return (c > tl->chunk_count);
+		}
+	}
+	tl->chunk_capacity = capacity;
+	return true;
+}
+
+/*
+	move every element into chunks of the size that suits the current length. runs when the
+	list has grown to four times the square of the chunk size, so its O(n) cost is amortized.
+*/
+bool _tiered_rebuild(TieredStringList *tl, const int chunk_size) {
+	TieredStringList *fresh = _tiered_new_sized(chunk_size);
+	if (fresh == NULL) {
+		return false;
+	}
+
+	for (int c = 0; c < tl->chunk_count; c++) {
+		_TieredChunk *chunk = &tl->chunks[c];
+		for (int o = 0; o < chunk->count; o++) {
+			if ((fresh->length == (fresh->chunk_count * fresh->chunk_size)) && !_tiered_reserve_chunk(fresh)) {
+				_tiered_free_chunks(fresh, false); // the strings still belong to 'tl'
+				free(fresh);
+				return false;
+			}
+			if (fresh->length == (fresh->chunk_count * fresh->chunk_size)) {
+				fresh->chunk_count++;
+			}
+			_TieredChunk *target = &fresh->chunks[(fresh->chunk_count - 1)];
+			_TIERED_AT(fresh, target, target->count) = _TIERED_AT(tl, chunk, o);
+			target->count++;
+			fresh->length++;
+		}
+	}
+
+	_tiered_free_chunks(tl, false);
+	*tl = *fresh;
+	free(fresh);
+	return true;
+}
+
+TieredStringList *tieredListInsert(TieredStringList *tl, const int index, const char *value) {
+	_LIST_TRACE(tieredListInsert, tl, tl->length);
+	assert(index >= 0);
+	assert(index <= tl->length); // inserting at the length appends
+
+	if (tl->length >= (4 * tl->chunk_size * tl->chunk_size)) {
+		_tiered_rebuild(tl, (tl->chunk_size * 2)); // on failure, keep going with the smaller chunks
+	}
+
+	char *copyBuf = malloc(strlen(value) + 1);
+	if (copyBuf == NULL) {
+		return NULL;
+	}
+	strcpy(copyBuf, value);
+
+	if (tl->length == (tl->chunk_count * tl->chunk_size)) { // every chunk is full
+		if (!_tiered_reserve_chunk(tl)) {
+			free(copyBuf);
+			return NULL;
+		}
+		tl->chunk_count++;
+	}
+
+	int mask = tl->chunk_size - 1;
+	int target = index >> tl->chunk_shift;
+
+	// from the back, hand the last element of each full chunk to the front of the next one
+	for (int c = (tl->chunk_count - 1); c > target; c--) {
+		_TieredChunk *from = &tl->chunks[(c - 1)];
+		_TieredChunk *to = &tl->chunks[c];
+		char *moved = _TIERED_AT(tl, from, (from->count - 1));
+		from->count--;
+		to->start = ((to->start - 1) & mask);
+		to->slots[to->start] = moved;
+		to->count++;
+	}
+
+	// the target chunk now has a free slot, shift its tail up to open the offset
+	_TieredChunk *chunk = &tl->chunks[target];
+	int offset = index & mask;
+	for (int o = chunk->count; o > offset; o--) {
+		_TIERED_AT(tl, chunk, o) = _TIERED_AT(tl, chunk, (o - 1));
+	}
+	_TIERED_AT(tl, chunk, offset) = copyBuf;
+	chunk->count++;
+
+	tl->length++;
+	return tl;
+}
+
+TieredStringList *tieredListAdd(TieredStringList *tl, const char *value) {
+	_LIST_TRACE(tieredListAdd, tl, tl->length);
+	return tieredListInsert(tl, tl->length, value);
+}
+
+TieredStringList *tieredListSet(TieredStringList *tl, const int index, const char *value) {
+	_LIST_TRACE(tieredListSet, tl, tl->length);
+	assert(index >= 0);
+	assert(index < tl->length);
+
+	char *copyBuf = malloc(strlen(value) + 1);
+	if (copyBuf == NULL) {
+		return NULL;
+	}
+	strcpy(copyBuf, value);
+
+	_TieredChunk *chunk = &tl->chunks[(index >> tl->chunk_shift)];
+	char **slot = &_TIERED_AT(tl, chunk, (index & (tl->chunk_size - 1)));
+	free(*slot);
+	*slot = copyBuf;
+	return tl;
+}
+
+void tieredListRemove(TieredStringList *tl, const int index) {
+	_LIST_TRACE(tieredListRemove, tl, tl->length);
+	assert(index >= 0);
+	assert(index < tl->length);
+
+	int mask = tl->chunk_size - 1;
+	int target = index >> tl->chunk_shift;
+
+	// close the gap inside the target chunk
+	_TieredChunk *chunk = &tl->chunks[target];
+	int offset = index & mask;
+	free(_TIERED_AT(tl, chunk, offset));
+	for (int o = offset; o < (chunk->count - 1); o++) {
+		_TIERED_AT(tl, chunk, o) = _TIERED_AT(tl, chunk, (o + 1));
+	}
+	chunk->count--;
+
+	// refill each chunk from the front of the next one so only the last chunk is partial
+	for (int c = (target + 1); c < tl->chunk_count; c++) {
+		_TieredChunk *from = &tl->chunks[c];
+		_TieredChunk *to = &tl->chunks[(c - 1)];
+		_TIERED_AT(tl, to, to->count) = from->slots[from->start];
+		to->count++;
+		from->start = ((from->start + 1) & mask);
+		from->count--;
+	}
+
+	if (tl->chunks[(tl->chunk_count - 1)].count == 0) {
+		tl->chunks[(tl->chunk_count - 1)].start = 0;
+		tl->chunk_count--; // the slots stay allocated for the next append
+	}
+	tl->length--;
+}
+
+int tieredListIndexOf(const TieredStringList *tl, const char *element) {
+	_LIST_TRACE(tieredListIndexOf, tl, tl->length);
+	for (int c = 0; c < tl->chunk_count; c++) {
+		_TieredChunk *chunk = &tl->chunks[c];
+		for (int o = 0; o < chunk->count; o++) {
+			if (strcmp(_TIERED_AT(tl, chunk, o), element) == 0) {
+				return (c << tl->chunk_shift) + o;
+			}
+		}
+	}
+	return -1;
+}
+
+TieredStringList *tieredListFromList(const StringList *sl) {
+	_LIST_TRACE(tieredListFromList, sl, sl->length);
+	int chunk_size = TIERED_MIN_CHUNK;
+	while (sl->length > (4 * chunk_size * chunk_size)) {
+		chunk_size *= 2;
+	}
+
+	TieredStringList *tl = _tiered_new_sized(chunk_size);
+	if (tl == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < sl->length; i++) {
+		if (tieredListAdd(tl, sl->list[i]) == NULL) {
+			tieredListDestroy(tl);
+			return NULL;
+		}
+	}
+	return tl;
+}
+
+StringList *tieredListToList(const TieredStringList *tl) {
+	_LIST_TRACE(tieredListToList, tl, tl->length);
+	StringList *result = listNewCapacity(tl->length);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	for (int c = 0; c < tl->chunk_count; c++) {
+		_TieredChunk *chunk = &tl->chunks[c];
+		for (int o = 0; o < chunk->count; o++) {
+			if (listAdd(result, _TIERED_AT(tl, chunk, o)) == NULL) {
+				listDestroy(result);
+				return NULL;
+			}
+		}
+	}
+	return result;
+}
+
+
+/**
+	concurrent lists: a ConcurrentStringList publishes an immutable StringList 'version' through an
+	atomic pointer. readers never lock: they announce the epoch they started in, load the current
+	version and read it directly. writers take a mutex, build the next version and publish it.
+	versions share their string buffers, so a write only copies the slot and metadata arrays and
+	allocates the strings it adds; the replaced version, and any string the write dropped, is
+	retired under the epoch that follows it. a later writer frees retired versions once every
+	reader still in progress started in that epoch or after, since those readers can only have
+	loaded a newer version. versions always carry metadata, so lookups use the search kernel.
+**/
+
+#define CONCURRENT_READER_SLOTS 64
+
+typedef struct {
+	_Alignas(64) atomic_uint_fast64_t epoch; // epoch the reader started in, 0 while the slot is free
+} _ConcurrentReaderSlot;
+
+typedef struct _ConcurrentRetired {
+	StringList *version;
+	bool release_strings; // the next version shares none of the strings of 'version'
+	char *garbage; // a string only 'version' used, or NULL
+	uint64_t epoch; // readers that started in this epoch or later never saw 'version'
+	struct _ConcurrentRetired *next;
+} _ConcurrentRetired;
+
+struct _ConcurrentStringList {
+	_ConcurrentReaderSlot readers[CONCURRENT_READER_SLOTS]; // first, so aligned_alloc lines them up
+	_Atomic(StringList *) current;
+	atomic_uint_fast64_t epoch;
+	pthread_mutex_t write_lock;
+	_ConcurrentRetired *retired; // guarded by 'write_lock'
+};
+
+atomic_uint _concurrent_next_slot = 0;
+_Thread_local int _concurrent_slot_hint = -1; // spreads threads over the slots so they do not share cache lines
+
+// a version with room for exactly 'length' elements, which the caller fills in
+StringList *_concurrent_version_new(const int length) {
+	StringList *version = listNewCapacity((length > 0) ? length : 1);
+	if (version == NULL) {
+		return NULL;
+	}
+	if (!_list_meta_resize(version, length)) {
+		listDestroy(version);
+		return NULL;
+	}
+	version->length = length;
+	return version;
+}
+
+// free a version, and its strings too when no other version uses them
+void _concurrent_version_free(StringList *version, const bool release_strings) {
+	if (!release_strings) {
+		version->length = 0; // the strings belong to a newer version
+	}
+	listDestroy(version);
+}
+
+// copy 'count' elements and their metadata from 'src' at 'from' into 'dst' at 'to', sharing the strings
+void _concurrent_copy(StringList *dst, const int to, const StringList *src, const int from, const int count) {
+	memcpy(&dst->list[to], &src->list[from], (count * sizeof(char*)));
+	memcpy(&dst->hashes[to], &src->hashes[from], (count * sizeof(uint32_t)));
+	memcpy(&dst->lengths[to], &src->lengths[from], (count * sizeof(uint32_t)));
+}
+
+// store a private copy of 'value' at 'index' of a version being built, false if memory ran out
+bool _concurrent_store(StringList *version, const int index, const char *value) {
+	size_t size = strlen(value) + 1;
+	version->list[index] = malloc(size);
+	if (version->list[index] == NULL) {
+		return false;
+	}
+	memcpy(version->list[index], value, size);
+	_list_meta_store(version, index);
+	return true;
+}
+
+// a version holding copies of every element of 'sl', NULL if memory ran out
+StringList *_concurrent_version_of(const StringList *sl) {
+	StringList *version = _concurrent_version_new(sl->length);
+	if (version == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < sl->length; i++) {
+		if (!_concurrent_store(version, i, sl->list[i])) {
+			version->length = i; // only release the copies made so far
+			_concurrent_version_free(version, true);
+			return NULL;
+		}
+	}
+	return version;
+}
+
+// copy the contents of 'sl' into a new concurrent list, NULL if memory ran out
+ConcurrentStringList *concurrentListFromList(const StringList *sl) {
+	_LIST_TRACE(concurrentListFromList, sl, sl->length);
+	size_t size = ((sizeof(ConcurrentStringList) + 63) / 64) * 64; // aligned_alloc wants a multiple of the alignment
+	ConcurrentStringList *cl = aligned_alloc(64, size);
+	if (cl == NULL) {
+		return NULL;
+	}
+
+	StringList *version = _concurrent_version_of(sl);
+	if (version == NULL) {
+		free(cl);
+		return NULL;
+	}
+
+	for (int i = 0; i < CONCURRENT_READER_SLOTS; i++) {
+		atomic_init(&cl->readers[i].epoch, 0);
+	}
+	atomic_init(&cl->current, version);
+	atomic_init(&cl->epoch, 1);
+	pthread_mutex_init(&cl->write_lock, NULL);
+	cl->retired = NULL;
+	return cl;
+}
+
+ConcurrentStringList *concurrentListNew() {
+	_LIST_TRACE(concurrentListNew, NULL, 0);
+	StringList empty = { 0 };
+	return concurrentListFromList(&empty);
+}
+
+void _concurrent_retired_free(_ConcurrentRetired *retired) {
+	_concurrent_version_free(retired->version, retired->release_strings);
+	free(retired->garbage);
+	free(retired);
+}
+
+// no other thread may be using 'cl' anymore
+void concurrentListDestroy(ConcurrentStringList *cl) {
+	_LIST_TRACE(concurrentListDestroy, cl, 0);
+	while (cl->retired != NULL) {
+		_ConcurrentRetired *retired = cl->retired;
+		cl->retired = retired->next;
+		_concurrent_retired_free(retired);
+	}
+	_concurrent_version_free(atomic_load(&cl->current), true);
+	pthread_mutex_destroy(&cl->write_lock);
+	free(cl);
+}
+
+/*
+	start reading: returns the current version, which stays valid and unchanged until
+	concurrentListReadEnd(cl, *slot). pass it only to functions that take a const StringList *,
+	other than listClone; use concurrentListSnapshot() for a list that outlives the read.
+*/
+const StringList *concurrentListReadBegin(ConcurrentStringList *cl, int *slot) {
+	_LIST_TRACE(concurrentListReadBegin, cl, 0);
+	if (_concurrent_slot_hint == -1) {
+		_concurrent_slot_hint = (atomic_fetch_add(&_concurrent_next_slot, 1) % CONCURRENT_READER_SLOTS);
+	}
+
+	uint64_t epoch = atomic_load(&cl->epoch);
+	int i = _concurrent_slot_hint;
+	while (true) {
+		uint_fast64_t idle = 0;
+		if ((atomic_load_explicit(&cl->readers[i].epoch, memory_order_relaxed) == 0) &&
+			atomic_compare_exchange_strong(&cl->readers[i].epoch, &idle, epoch)) {
+			break;
+		}
+		i = ((i + 1) % CONCURRENT_READER_SLOTS);
+		if (i == _concurrent_slot_hint) {
+			sched_yield(); // every slot is taken, let a reader finish
+		}
+	}
+
+	*slot = i;
+	return atomic_load(&cl->current); // ordered after the announcement, so a writer that missed it has already published
+}
+
+void concurrentListReadEnd(ConcurrentStringList *cl, const int slot) {
+	_LIST_TRACE(concurrentListReadEnd, cl, 0);
+	atomic_store(&cl->readers[slot].epoch, 0);
+}
+
+// a copy of the current contents that the caller owns, NULL if memory ran out
+StringList *concurrentListSnapshot(ConcurrentStringList *cl) {
+	_LIST_TRACE(concurrentListSnapshot, cl, 0);
+	int slot;
+	const StringList *version = concurrentListReadBegin(cl, &slot);
+	StringList *result = listSublist(version, 0, version->length);
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+int concurrentListLength(ConcurrentStringList *cl) {
+	_LIST_TRACE(concurrentListLength, cl, 0);
+	int slot;
+	int result = listLength(concurrentListReadBegin(cl, &slot));
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+// a copy of the element at 'index' that the caller must free(), NULL if 'index' is out of range or memory ran out
+char *concurrentListGet(ConcurrentStringList *cl, const int index) {
+	_LIST_TRACE(concurrentListGet, cl, 0);
+	int slot;
+	const StringList *version = concurrentListReadBegin(cl, &slot);
+	char *result = NULL;
+	if ((index >= 0) && (index < version->length)) {
+		size_t size = strlen(version->list[index]) + 1;
+		result = malloc(size);
+		if (result != NULL) {
+			memcpy(result, version->list[index], size);
+		}
+	}
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+int concurrentListIndexOf(ConcurrentStringList *cl, const char *element) {
+	_LIST_TRACE(concurrentListIndexOf, cl, 0);
+	int slot;
+	int result = listIndexOf(concurrentListReadBegin(cl, &slot), element);
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+bool concurrentListContains(ConcurrentStringList *cl, const char *element) {
+	_LIST_TRACE(concurrentListContains, cl, 0);
+	int slot;
+	bool result = listContains(concurrentListReadBegin(cl, &slot), element);
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+bool concurrentListContainsAll(ConcurrentStringList *cl, const StringList *must_contain) {
+	_LIST_TRACE(concurrentListContainsAll, cl, 0);
+	int slot;
+	bool result = listContainsAll(concurrentListReadBegin(cl, &slot), must_contain);
+	concurrentListReadEnd(cl, slot);
+	return result;
+}
+
+// free every retired version that no reader in progress can still be reading, 'cl->write_lock' must be held
+void _concurrent_reclaim(ConcurrentStringList *cl) {
+	uint64_t oldest = UINT64_MAX;
+	for (int i = 0; i < CONCURRENT_READER_SLOTS; i++) {
+		uint64_t epoch = atomic_load(&cl->readers[i].epoch);
+		if ((epoch != 0) && (epoch < oldest)) {
+			oldest = epoch;
+		}
+	}
+
+	_ConcurrentRetired **link = &cl->retired;
+	while (*link != NULL) {
+		_ConcurrentRetired *retired = *link;
+		if (retired->epoch <= oldest) {
+			*link = retired->next;
+			_concurrent_retired_free(retired);
+		} else {
+			link = &retired->next;
+		}
+	}
+}
+
+/*
+	a write in progress: 'build' makes 'next' from 'current', the version it replaces, and sets
+	'release_strings' or 'garbage' for the strings 'next' no longer uses. returns false, having
+	freed anything it allocated, if the write cannot be made.
+*/
+typedef struct {
+	const StringList *current;
+	StringList *next;
+	bool release_strings;
+	char *garbage;
+	int index;
+	const char *value;
+	const StringList *src;
+	bool (*update_funct)(StringList *, void *);
+	void *context;
+} _ConcurrentWrite;
+
+// run one write under the writer lock and publish its result, false if nothing was published
+bool _concurrent_write(ConcurrentStringList *cl, bool (*build)(_ConcurrentWrite *), _ConcurrentWrite *write) {
+	_ConcurrentRetired *retired = malloc(sizeof(_ConcurrentRetired));
+	if (retired == NULL) {
+		return false;
+	}
+
+	pthread_mutex_lock(&cl->write_lock);
+	write->current = atomic_load(&cl->current);
+	write->release_strings = false;
+	write->garbage = NULL;
+	if (!build(write)) {
+		pthread_mutex_unlock(&cl->write_lock);
+		free(retired);
+		return false;
+	}
+
+	atomic_store(&cl->current, write->next);
+	retired->version = (StringList *) write->current;
+	retired->release_strings = write->release_strings;
+	retired->garbage = write->garbage;
+	retired->epoch = (atomic_fetch_add(&cl->epoch, 1) + 1); // readers announcing this epoch load 'next'
+	retired->next = cl->retired;
+	cl->retired = retired;
+	_concurrent_reclaim(cl);
+	pthread_mutex_unlock(&cl->write_lock);
+	return true;
+}
+
+// 'next' is 'current' with 'count' new elements copied from 'values' (or 'value' if NULL) at 'index'
+bool _concurrent_build_insert(_ConcurrentWrite *write, const StringList *values, const int count) {
+	const StringList *current = write->current;
+	write->next = _concurrent_version_new(current->length + count);
+	if (write->next == NULL) {
+		return false;
+	}
+
+	_concurrent_copy(write->next, 0, current, 0, write->index);
+	_concurrent_copy(write->next, (write->index + count), current, write->index, (current->length - write->index));
+	for (int i = 0; i < count; i++) {
+		if (!_concurrent_store(write->next, (write->index + i), ((values != NULL) ? values->list[i] : write->value))) {
+			for (int j = 0; j < i; j++) {
+				free(write->next->list[(write->index + j)]);
+			}
+			_concurrent_version_free(write->next, false);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool _concurrent_build_insert_one(_ConcurrentWrite *write) {
+	if (write->index == -1) {
+		write->index = write->current->length; // append
+	}
+	if ((write->index < 0) || (write->index > write->current->length)) {
+		return false;
+	}
+	return _concurrent_build_insert(write, NULL, 1);
+}
+
+bool _concurrent_build_add_all(_ConcurrentWrite *write) {
+	write->index = write->current->length;
+	return _concurrent_build_insert(write, write->src, write->src->length);
+}
+
+bool _concurrent_build_set(_ConcurrentWrite *write) {
+	const StringList *current = write->current;
+	if ((write->index < 0) || (write->index >= current->length)) {
+		return false;
+	}
+
+	write->next = _concurrent_version_new(current->length);
+	if (write->next == NULL) {
+		return false;
+	}
+	_concurrent_copy(write->next, 0, current, 0, current->length);
+	if (!_concurrent_store(write->next, write->index, write->value)) {
+		_concurrent_version_free(write->next, false);
+		return false;
+	}
+	write->garbage = current->list[write->index];
+	return true;
+}
+
+bool _concurrent_build_remove(_ConcurrentWrite *write) {
+	const StringList *current = write->current;
+	if (write->value != NULL) {
+		write->index = listIndexOf(current, write->value);
+	}
+	if ((write->index < 0) || (write->index >= current->length)) {
+		return false;
+	}
+
+	write->next = _concurrent_version_new(current->length - 1);
+	if (write->next == NULL) {
+		return false;
+	}
+	_concurrent_copy(write->next, 0, current, 0, write->index);
+	_concurrent_copy(write->next, write->index, current, (write->index + 1), (current->length - write->index - 1));
+	write->garbage = current->list[write->index];
+	return true;
+}
+
+bool _concurrent_build_clear(_ConcurrentWrite *write) {
+	write->next = _concurrent_version_new(0);
+	write->release_strings = true;
+	return (write->next != NULL);
+}
+
+// run the caller's update on a private deep copy, then turn the result into the next version
+bool _concurrent_build_update(_ConcurrentWrite *write) {
+	StringList *working = listSublist(write->current, 0, write->current->length);
+	if (working == NULL) {
+		return false;
+	}
+	if (!write->update_funct(working, write->context)) {
+		listDestroy(working);
+		return false;
+	}
+
+	write->next = _concurrent_version_of(working);
+	write->release_strings = true;
+	listDestroy(working);
+	return (write->next != NULL);
+}
+
+/*
+	run 'update_funct' on a private copy of the current contents and publish the result, for
+	changes the other writers do not cover. it copies every string twice, so prefer those. if
+	'update_funct' returns false or memory runs out, nothing is published and false is returned.
+*/
+bool concurrentListUpdate(ConcurrentStringList *cl, bool (*update_funct)(StringList *, void *), void *context) {
+	_LIST_TRACE(concurrentListUpdate, cl, 0);
+	_ConcurrentWrite write = { .update_funct = update_funct, .context = context };
+	return _concurrent_write(cl, &_concurrent_build_update, &write);
+}
+
+// false if 'index' is out of range or memory ran out
+bool concurrentListSet(ConcurrentStringList *cl, const int index, const char *value) {
+	_LIST_TRACE(concurrentListSet, cl, 0);
+	_ConcurrentWrite write = { .index = index, .value = value };
+	return _concurrent_write(cl, &_concurrent_build_set, &write);
+}
+
+bool concurrentListAdd(ConcurrentStringList *cl, const char *value) {
+	_LIST_TRACE(concurrentListAdd, cl, 0);
+	_ConcurrentWrite write = { .index = -1, .value = value };
+	return _concurrent_write(cl, &_concurrent_build_insert_one, &write);
+}
+
+bool concurrentListAddAll(ConcurrentStringList *cl, const StringList *src) {
+	_LIST_TRACE(concurrentListAddAll, cl, 0);
+	_ConcurrentWrite write = { .src = src };
+	return _concurrent_write(cl, &_concurrent_build_add_all, &write);
+}
+
+// 'index' may equal the length to append, false if it is out of range or memory ran out
+bool concurrentListInsert(ConcurrentStringList *cl, const int index, const char *value) {
+	_LIST_TRACE(concurrentListInsert, cl, 0);
+	if (index < 0) {
+		return false;
+	}
+	_ConcurrentWrite write = { .index = index, .value = value };
+	return _concurrent_write(cl, &_concurrent_build_insert_one, &write);
+}
+
+bool concurrentListRemove(ConcurrentStringList *cl, const int index) {
+	_LIST_TRACE(concurrentListRemove, cl, 0);
+	_ConcurrentWrite write = { .index = index };
+	return _concurrent_write(cl, &_concurrent_build_remove, &write);
+}
+
+// remove the first occurrence of 'element', false if it was not in the list or memory ran out
+bool concurrentListRemoveElement(ConcurrentStringList *cl, const char *element) {
+	_LIST_TRACE(concurrentListRemoveElement, cl, 0);
+	_ConcurrentWrite write = { .value = element };
+	return _concurrent_write(cl, &_concurrent_build_remove, &write);
+}
+
+bool concurrentListClear(ConcurrentStringList *cl) {
+	_LIST_TRACE(concurrentListClear, cl, 0);
+	_ConcurrentWrite write = { 0 };
+	return _concurrent_write(cl, &_concurrent_build_clear, &write);
+}
+
+
+/**
+	append lists: producers on any number of threads add to one AppendStringList without a lock.
+	each add copies its string, makes sure the segment of the next index exists, claims that index
+	with a compare-and-swap and stores the copy in its slot. slots live in segments that double in
+	size and are never moved, so there is no realloc to serialize on; the first producer to reach a
+	segment allocates it, before any index in it is handed out, so running out of memory never
+	leaves a reserved slot that nobody can fill. slots can
+	fill out of order, so the list publishes the longest prefix of filled slots, which any
+	producer or reader advances as it goes; readers only see elements below that length.
+**/
+
+#define APPEND_FIRST_SEGMENT 64 // slots in segment 0, segment k holds APPEND_FIRST_SEGMENT << k
+#define APPEND_SEGMENTS 26 // enough segments for every non-negative int index
+
+struct _AppendStringList {
+	_Atomic(_Atomic(char *) *) segments[APPEND_SEGMENTS];
+	atomic_int reserved; // slots handed out to producers
+	atomic_int published; // every slot below this is filled
+};
+
+// the segment holding slot 'index', and the slot's offset within it
+int _append_segment_of(const int index, int *offset) {
+	unsigned int blocks = ((unsigned int) index / APPEND_FIRST_SEGMENT) + 1;
+	int segment = 31 - __builtin_clz(blocks);
+	*offset = index - (APPEND_FIRST_SEGMENT * ((1 << segment) - 1));
+	return segment;
+}
+
+AppendStringList *appendListNew() {
+	_LIST_TRACE(appendListNew, NULL, 0);
+	AppendStringList *al = malloc(sizeof(AppendStringList));
+	if (al == NULL) {
+		return NULL;
+	}
+
+	for (int k = 0; k < APPEND_SEGMENTS; k++) {
+		atomic_init(&al->segments[k], NULL);
+	}
+	atomic_init(&al->reserved, 0);
+	atomic_init(&al->published, 0);
+	return al;
+}
+
+// no producer or reader may be using 'al' anymore
+void appendListDestroy(AppendStringList *al) {
+	_LIST_TRACE(appendListDestroy, al, 0);
+	int reserved = atomic_load(&al->reserved);
+	for (int k = 0; k < APPEND_SEGMENTS; k++) {
+		_Atomic(char *) *slots = atomic_load(&al->segments[k]);
+		if (slots == NULL) {
+			continue;
+		}
+		int first = APPEND_FIRST_SEGMENT * ((1 << k) - 1);
+		for (int i = 0; ((size_t) i < ((size_t) APPEND_FIRST_SEGMENT << k)) && ((first + i) < reserved); i++) {
+			free(atomic_load(&slots[i]));
+		}
+		free(slots);
+	}
+	free(al);
+}
+
+// the slots of 'segment', allocating them if no producer has yet, NULL if memory ran out
+_Atomic(char *) *_append_segment(AppendStringList *al, const int segment) {
+	_Atomic(char *) *slots = atomic_load(&al->segments[segment]);
+	if (slots != NULL) {
+		return slots;
+	}
+
+	_Atomic(char *) *fresh = calloc(((size_t) APPEND_FIRST_SEGMENT << segment), sizeof(_Atomic(char *))); // NULL marks an unfilled slot
+	if (fresh == NULL) {
+		return NULL;
+	}
+	if (!atomic_compare_exchange_strong(&al->segments[segment], &slots, fresh)) {
+		free(fresh); // another producer installed it first, 'slots' now holds theirs
+		return slots;
+	}
+	return fresh;
+}
+
+// move the published length past every slot that has been filled since
+void _append_publish(AppendStringList *al) {
+	int published = atomic_load(&al->published);
+	while (published < atomic_load(&al->reserved)) {
+		int offset;
+		_Atomic(char *) *slots = atomic_load(&al->segments[_append_segment_of(published, &offset)]);
+		if ((slots == NULL) || (atomic_load(&slots[offset]) == NULL)) {
+			return; // still being filled, its producer will see the published length reach it
+		}
+		if (atomic_compare_exchange_weak(&al->published, &published, (published + 1))) {
+			published++; // carry on from the slot just published, later ones may already be filled
+		} // on failure 'published' is reloaded
+	}
+}
+
+// safe to call from any number of threads at once, false if memory ran out and nothing was added
+bool appendListAdd(AppendStringList *al, const char *value) {
+	_LIST_TRACE(appendListAdd, al, 0);
+	size_t size = strlen(value) + 1;
+	char *copy = malloc(size); // copied before reserving, a reserved slot must always be filled
+	if (copy == NULL) {
+		return false;
+	}
+	memcpy(copy, value, size);
+
+	int index = atomic_load(&al->reserved);
+	int offset;
+	_Atomic(char *) *slots;
+	do { // on failure 'index' is reloaded and its segment checked again
+		assert(index < INT_MAX); // the segments cover every non-negative int
+		slots = _append_segment(al, _append_segment_of(index, &offset));
+		if (slots == NULL) {
+			free(copy); // nothing was reserved, the list is unchanged
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak(&al->reserved, &index, (index + 1)));
+
+	atomic_store(&slots[offset], copy); // sequentially consistent, so either this producer or the one publishing ahead sees the other
+	_append_publish(al);
+	return true;
+}
+
+// the published length: elements [0, length) are all readable, more may be on their way
+int appendListLength(AppendStringList *al) {
+	_LIST_TRACE(appendListLength, al, 0);
+	_append_publish(al);
+	return atomic_load(&al->published);
+}
+
+// 'index' must be below a length returned by appendListLength(); elements never move or change
+char *appendListGet(AppendStringList *al, const int index) {
+	_LIST_TRACE(appendListGet, al, 0);
+	assert(index >= 0);
+	assert(index < atomic_load(&al->published));
+
+	int offset;
+	_Atomic(char *) *slots = atomic_load(&al->segments[_append_segment_of(index, &offset)]);
+	return atomic_load_explicit(&slots[offset], memory_order_acquire);
+}
+
+// a StringList holding copies of the published elements, NULL if memory ran out
+StringList *appendListToList(AppendStringList *al) {
+	_LIST_TRACE(appendListToList, al, 0);
+	int length = appendListLength(al);
+	StringList *result = listNewCapacity((length > 0) ? length : 1);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < length; i++) {
+		if (listAdd(result, appendListGet(al, i)) == NULL) {
+			listDestroy(result);
+			return NULL;
+		}
+	}
+	return result;
 }
@@ -1,13 +1,86 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// strings shorter than this many bytes are stored inline by lists created with listNewInline()
+#define LIST_INLINE_CELL 16
+
+typedef struct _ListArena ListArena;
+typedef struct _ListCells ListCells;
+typedef struct _ListIndex ListIndex;
+typedef struct _ListShare ListShare;
+typedef struct _ListBorrowed ListBorrowed;
+typedef struct _ListMapping ListMapping;
+
+// memory callbacks for a list, each called with 'context' as its first argument
+// 'realloc_funct' and 'free_funct' are never passed a NULL block
 typedef struct {
-	char **list;
+	void *(*alloc_funct)(void *context, size_t size);
+	void *(*realloc_funct)(void *context, void *block, size_t size);
+	void (*free_funct)(void *context, void *block);
+	void *context;
+} ListAllocator;
+
+// per-list operation counts; all but 'expansions' are only counted in builds with -DLIST_STATS
+typedef struct {
+	long expansions; // reallocations made by automatic growth
+	long compares; // element comparisons made by lookups and equality checks
+	long shifts; // slots moved to open or close gaps
+	long allocations; // element buffers and slot array reallocations requested
+} ListCounters;
+
+typedef struct {
+	char **list; // element 0 onwards, may start 'head' slots into the allocation
 	int length;
-	int capacity;
+	int capacity; // allocated slots, head room included; appends fit in capacity - head - length
+	int head; // free slots in front of element 0, left by front removals and kept for front inserts
+	ListArena *arena; // NULL unless the list was created with listNewArena()
+	ListCells *cells; // NULL unless the list was created with listNewInline()
+	ListMapping *mapping; // NULL unless the list was opened with listOpenMapped()
+	ListIndex *index; // NULL unless enabled with listEnableIndex()
+	int (*sorted_by)(const char *, const char *); // comparator the list is known to be sorted by, or NULL
+	uint32_t *hashes; // per-element hashes, NULL unless enabled with listEnableMetadata()
+	uint32_t *lengths; // per-element lengths, allocated together with 'hashes'
+	ListShare *share; // reference count of the storage, which listClone() shares with the clone
+	ListBorrowed *borrowed; // strings still read from a clone's storage after a write, NULL if none
+	double growth; // capacity multiplier when the list is full, 2 unless set with listSetGrowthPolicy()
+	int max_step; // most slots a single growth may add, 0 for no limit
+	double shrink_below; // fill fraction under which removals shrink the list, 0 to never shrink
+	int reserved; // capacity reserved through listEnsureCapacity(), auto-shrink keeps at least this much
+	ListAllocator allocator; // source of every block the list uses
+	ListCounters counters;
 } StringList;
 
+// memory use of a list, as reported by listStats()
+typedef struct {
+	int length;
+	int capacity; // allocated slots, including head room
+	size_t slot_bytes;
+	size_t metadata_bytes; // per-element hashes and lengths
+	size_t index_bytes; // hash index table and its key copies
+	size_t element_bytes; // element strings, or the whole arena or cell block holding them
+	size_t overhead_bytes; // allocator bookkeeping around heap element buffers, when known
+	bool overhead_known;
+	double slack; // fraction of the allocated slots not holding an element
+	bool shared; // storage is shared with a clone
+	ListCounters counters;
+} ListStats;
+
+// a window over elements [from, to) of a list, valid until the list is next modified
+typedef struct {
+	const StringList *list;
+	int from;
+	int to;
+} StringListView;
+
 StringList *listNew();
 StringList *listNewCapacity(const int capacity);
+StringList *listNewWithAllocator(const int capacity, const ListAllocator *allocator);
+StringList *listNewArena(const int capacity, const size_t arena_bytes);
+StringList *listNewInline(const int capacity);
+StringList *listNewSorted(const int capacity, int (*comparator_funct)(const char *, const char *));
 StringList *listSublist(const StringList *list, const int from, const int to);
 StringList *listClone(const StringList *list);
 void listDestroy(StringList *list);
@@ -15,6 +88,18 @@ void listDestroy(StringList *list);
 StringList *listSetCapacity(StringList *list, const int new_capacity);
 StringList *listEnsureCapacity(StringList *list, const int min_capacity);
 StringList *listTrimCapacity(StringList *list);
+StringList *listSetGrowthPolicy(StringList *list, const double factor, const int max_step);
+StringList *listSetShrinkPolicy(StringList *list, const double below);
+StringList *listCompactArena(StringList *list);
+
+// lookups on an indexed list only read the index, so they are safe alongside other readers;
+// inserts and removals that move elements rebuild its positions before returning
+StringList *listEnableIndex(StringList *list);
+void listDisableIndex(StringList *list);
+
+StringList *listEnableMetadata(StringList *list);
+void listDisableMetadata(StringList *list);
+const char *listSearchKernel();
 
 StringList *listSet(StringList *list, const int index, const char *value);
 StringList *listAdd(StringList *list, const char *value);
@@ -22,7 +107,12 @@ StringList *listAddAll(StringList *list, const StringList *source);
 StringList *listInsert(StringList *list, const int index, const char *value);
 StringList *listInsertAll(StringList *list, const int index, const StringList *source);
 
-int listCapacity(const StringList *list);
+StringList *listSetOwned(StringList *list, const int index, char *value);
+StringList *listAddOwned(StringList *list, char *value);
+StringList *listInsertOwned(StringList *list, const int index, char *value);
+StringList *listMoveAll(StringList *destination, StringList *source);
+
+int listCapacity(const StringList *list); // the whole allocation, front removals don't reduce it
 int listLength(const StringList *list);
 char *listGet(const StringList *list, const int index);
 int listIndexOf(const StringList *list, const char *element);
@@ -33,11 +123,160 @@ bool listContains(const StringList *list, const char *element);
 bool listContainsAll(const StringList *list, const StringList *must_contain);
 bool listEquals(const StringList *list_a, const StringList *list_b);
 
+StringListView listView(const StringList *list, const int from, const int to);
+int viewLength(const StringListView view);
+char *viewGet(const StringListView view, const int index);
+int viewIndexOf(const StringListView view, const char *element);
+int viewLastIndexOf(const StringListView view, const char *element);
+bool viewContains(const StringListView view, const char *element);
+bool viewEquals(const StringListView view_a, const StringListView view_b);
+
 void listRemove(StringList *list, const int index);
+char *listTake(StringList *list, const int index);
 void listRemoveElement(StringList *list, const char *element);
+void listRemoveRange(StringList *list, const int from, const int to);
 void listRemoveElements(StringList *list, const char *element);
 void listRemoveIf(StringList *list, bool(*conditional_funct)(const char *));
 void listRemoveAll(StringList *list, const StringList *to_remove);
+StringList *listRetainAll(StringList *list, const StringList *to_keep);
 void listClear(StringList *list);
 
+StringList *listIntersection(const StringList *list_a, const StringList *list_b);
+StringList *listUnion(const StringList *list_a, const StringList *list_b);
+StringList *listDifference(const StringList *list_a, const StringList *list_b);
+
+StringList *listSort(StringList *list, int (*comparator_funct)(const char *, const char *));
+StringList *listSortLexicographic(StringList *list);
+StringList *listSortParallel(StringList *list, int (*comparator_funct)(const char *, const char *), const int nthreads);
+
+StringList *listSortedInsert(StringList *list, const char *value);
+int listBinarySearch(const StringList *list, const char *element);
+int listLowerBound(const StringList *list, const char *element);
+int listUpperBound(const StringList *list, const char *element);
+
+// 'nthreads' is how many parts the work is split into, run by at most one thread per processor
+int listParallelIndexOf(const StringList *list, const char *element, const int nthreads);
+int listParallelCount(const StringList *list, bool (*conditional_funct)(const char *), const int nthreads);
+bool listParallelEquals(const StringList *list_a, const StringList *list_b, const int nthreads);
+void listParallelRemoveIf(StringList *list, bool (*conditional_funct)(const char *), const int nthreads);
+
+void listStats(const StringList *list, ListStats *stats);
+
+char *listJoin(const StringList *list, const char *separator);
+bool listWrite(const StringList *list, FILE *file, const char *separator);
 void listPrint(const StringList *list);
+
+bool listSave(const StringList *list, const char *path);
+StringList *listOpenMapped(const char *path);
+StringList *listLoadLines(const char *path, const char delimiter);
+StringList *listReadLines(FILE *file, const char delimiter);
+
+typedef struct _TieredStringList TieredStringList;
+
+TieredStringList *tieredListNew();
+TieredStringList *tieredListFromList(const StringList *list);
+StringList *tieredListToList(const TieredStringList *list);
+void tieredListDestroy(TieredStringList *list);
+
+TieredStringList *tieredListSet(TieredStringList *list, const int index, const char *value);
+TieredStringList *tieredListAdd(TieredStringList *list, const char *value);
+TieredStringList *tieredListInsert(TieredStringList *list, const int index, const char *value);
+void tieredListRemove(TieredStringList *list, const int index);
+
+int tieredListLength(const TieredStringList *list);
+char *tieredListGet(const TieredStringList *list, const int index);
+int tieredListIndexOf(const TieredStringList *list, const char *element);
+
+typedef struct _ConcurrentStringList ConcurrentStringList;
+
+ConcurrentStringList *concurrentListNew();
+ConcurrentStringList *concurrentListFromList(const StringList *list);
+void concurrentListDestroy(ConcurrentStringList *list);
+
+const StringList *concurrentListReadBegin(ConcurrentStringList *list, int *slot);
+void concurrentListReadEnd(ConcurrentStringList *list, const int slot);
+StringList *concurrentListSnapshot(ConcurrentStringList *list);
+
+int concurrentListLength(ConcurrentStringList *list);
+char *concurrentListGet(ConcurrentStringList *list, const int index);
+int concurrentListIndexOf(ConcurrentStringList *list, const char *element);
+bool concurrentListContains(ConcurrentStringList *list, const char *element);
+bool concurrentListContainsAll(ConcurrentStringList *list, const StringList *must_contain);
+
+bool concurrentListUpdate(ConcurrentStringList *list, bool (*update_funct)(StringList *, void *), void *context);
+bool concurrentListSet(ConcurrentStringList *list, const int index, const char *value);
+bool concurrentListAdd(ConcurrentStringList *list, const char *value);
+bool concurrentListAddAll(ConcurrentStringList *list, const StringList *src);
+bool concurrentListInsert(ConcurrentStringList *list, const int index, const char *value);
+bool concurrentListRemove(ConcurrentStringList *list, const int index);
+bool concurrentListRemoveElement(ConcurrentStringList *list, const char *element);
+bool concurrentListClear(ConcurrentStringList *list);
+
+typedef struct _AppendStringList AppendStringList;
+
+AppendStringList *appendListNew();
+void appendListDestroy(AppendStringList *list);
+bool appendListAdd(AppendStringList *list, const char *value);
+int appendListLength(AppendStringList *list);
+char *appendListGet(AppendStringList *list, const int index);
+StringList *appendListToList(AppendStringList *list);
+
+/*
+	tracing: in builds with -DLIST_TRACE, every function in this header reports its operation, the list
+	it was called on, that list's length at entry and the elapsed nanoseconds to each hook added
+	with listAddTraceHook(). calls made from inside another list function are not reported
+	separately. concurrent and append lists report a count of 0, since their length can change at any time.
+	without the flag, hooks can still be added but are never called.
+*/
+#define LIST_OPERATIONS(X) \
+	X(listNew) X(listNewCapacity) X(listNewWithAllocator) X(listNewArena) X(listNewInline) \
+	X(listNewSorted) X(listSublist) X(listClone) X(listDestroy) X(listSetCapacity) \
+	X(listEnsureCapacity) X(listTrimCapacity) X(listSetGrowthPolicy) X(listSetShrinkPolicy) \
+	X(listCompactArena) X(listEnableIndex) X(listDisableIndex) X(listEnableMetadata) \
+	X(listDisableMetadata) X(listSearchKernel) X(listSet) X(listAdd) X(listAddAll) \
+	X(listInsert) X(listInsertAll) X(listSetOwned) X(listAddOwned) X(listInsertOwned) \
+	X(listMoveAll) X(listCapacity) X(listLength) X(listGet) X(listIndexOf) X(listLastIndexOf) \
+	X(listIsEmpty) X(listContains) X(listContainsAll) X(listEquals) X(listView) X(viewLength) \
+	X(viewGet) X(viewIndexOf) X(viewLastIndexOf) X(viewContains) X(viewEquals) X(listRemove) \
+	X(listTake) X(listRemoveElement) X(listRemoveRange) X(listRemoveElements) X(listRemoveIf) \
+	X(listRemoveAll) X(listRetainAll) X(listClear) X(listIntersection) X(listUnion) \
+	X(listDifference) X(listSort) X(listSortLexicographic) X(listSortParallel) X(listSortedInsert) \
+	X(listBinarySearch) X(listLowerBound) X(listUpperBound) X(listParallelIndexOf) \
+	X(listParallelCount) X(listParallelEquals) X(listParallelRemoveIf) X(listStats) \
+	X(listJoin) X(listWrite) X(listPrint) X(listSave) X(listOpenMapped) X(listLoadLines) \
+	X(listReadLines) X(tieredListNew) X(tieredListFromList) X(tieredListToList) X(tieredListDestroy) \
+	X(tieredListSet) X(tieredListAdd) X(tieredListInsert) X(tieredListRemove) X(tieredListLength) \
+	X(tieredListGet) X(tieredListIndexOf) X(concurrentListNew) X(concurrentListFromList) \
+	X(concurrentListDestroy) X(concurrentListReadBegin) X(concurrentListReadEnd) \
+	X(concurrentListSnapshot) X(concurrentListLength) X(concurrentListGet) X(concurrentListIndexOf) \
+	X(concurrentListContains) X(concurrentListContainsAll) X(concurrentListUpdate) \
+	X(concurrentListSet) X(concurrentListAdd) X(concurrentListAddAll) X(concurrentListInsert) \
+	X(concurrentListRemove) X(concurrentListRemoveElement) X(concurrentListClear) X(appendListNew) \
+	X(appendListDestroy) X(appendListAdd) X(appendListLength) X(appendListGet) X(appendListToList)
+
+#define LIST_OP_ENUM(name) LIST_OP_##name,
+typedef enum {
+	LIST_OPERATIONS(LIST_OP_ENUM)
+	LIST_OP_COUNT
+} ListOperation;
+
+typedef void (*ListTraceHook)(const ListOperation operation, const void *list, const int count, const uint64_t nanoseconds, void *context);
+
+#define LIST_TRACE_HOOKS 8
+#define LIST_HISTOGRAM_BUCKETS 40 // bucket b counts calls taking [2^b, 2^(b + 1)) ns, the last one everything longer
+#define LIST_HISTOGRAM_SIZES 32 // size class c covers element counts in [2^c, 2^(c + 1)), class 0 also counts 0
+
+// the built-in collector for listHistogramHook, zero-initialize it before use
+typedef struct {
+	uint64_t buckets[LIST_OP_COUNT][LIST_HISTOGRAM_BUCKETS];
+	uint64_t size_calls[LIST_OP_COUNT][LIST_HISTOGRAM_SIZES]; // calls per size class of 'count'
+	uint64_t size_nanoseconds[LIST_OP_COUNT][LIST_HISTOGRAM_SIZES]; // total time per size class
+} ListHistogram;
+
+bool listAddTraceHook(ListTraceHook hook, void *context);
+void listClearTraceHooks();
+const char *listOperationName(const ListOperation operation);
+
+void listHistogramHook(const ListOperation operation, const void *list, const int count, const uint64_t nanoseconds, void *histogram);
+uint64_t listHistogramPercentile(const ListHistogram *histogram, const ListOperation operation, const double percentile);
+void listHistogramPrint(const ListHistogram *histogram);
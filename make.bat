@@ -1,5 +1,5 @@
 @echo off
-gcc -Wall -std=c11 -g -o tests list.c tests.c
+gcc -Wall -std=c11 -g -pthread -o tests list.c tests.c
 pause
 tests.exe
 pause
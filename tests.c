@@ -1,8 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "list.h"
 
@@ -285,6 +289,12 @@ bool test_trim_capacity() {
 
 	bool result = (listCapacity(list) == listLength(list));
 
+	// an empty list trims to nothing and can still grow again
+	listClear(list);
+	result = result && (listTrimCapacity(list) != NULL) && (listCapacity(list) == 0);
+	listAdd(list, "abc");
+	result = result && (listLength(list) == 1) && (strcmp(listGet(list, 0), "abc") == 0);
+
 	listDestroy(list);
 
 	return result;
@@ -558,6 +568,32 @@ bool test_clear() {
 	return result;
 }
 
+bool test_remove_range() {
+	announce_test("list_remove_range");
+
+	StringList* list = listNew();
+	listAdd(list, "a");
+	listAdd(list, "b");
+	listAdd(list, "c");
+	listAdd(list, "d");
+	listAdd(list, "e");
+
+	listRemoveRange(list, 1, 3);
+	listRemoveRange(list, 2, 2); // empty range is a no-op
+
+	StringList* expected = listNew();
+	listAdd(expected, "a");
+	listAdd(expected, "d");
+	listAdd(expected, "e");
+
+	bool result = listEquals(list, expected);
+
+	listDestroy(list);
+	listDestroy(expected);
+
+	return result;
+}
+
 bool test_contains_all() {
 	announce_test("list_contains_all");
 
@@ -593,6 +629,1910 @@ bool test_contains_all() {
 	return result;
 }
 
+bool test_new_arena() {
+	announce_test("list_new_arena");
+
+	StringList* list = listNewArena(2, 64); // small chunks to force several of them
+	for (int i = 0; i < 20; i++) {
+		listAdd(list, "abcdefgh");
+	}
+	listAdd(list, "a string long enough to be given its own dedicated arena chunk");
+	listSet(list, 0, "xyz");
+	listRemove(list, 1);
+
+	StringList* expected = listNew();
+	listAdd(expected, "xyz");
+	for (int i = 2; i < 20; i++) {
+		listAdd(expected, "abcdefgh");
+	}
+	listAdd(expected, "a string long enough to be given its own dedicated arena chunk");
+
+	bool result_a = listEquals(list, expected);
+
+	listClear(list);
+	listAdd(list, "after clear");
+
+	bool result = (
+		result_a &&
+		(listLength(list) == 1) &&
+		(strcmp(listGet(list, 0), "after clear") == 0)
+	);
+
+	listDestroy(list);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_compact_arena() {
+	announce_test("list_compact_arena");
+
+	StringList* list = listNewArena(10, 32);
+	listAdd(list, "a");
+	listAdd(list, "b");
+	listAdd(list, "c");
+	listSet(list, 1, "bb");
+	listRemove(list, 0);
+
+	StringList* clone = listClone(list);
+
+	listCompactArena(list);
+
+	StringList* expected = listNew();
+	listAdd(expected, "bb");
+	listAdd(expected, "c");
+
+	bool result = (
+		listEquals(list, expected) &&
+		listEquals(clone, expected) &&
+		(clone->arena != NULL) && // clones keep the storage mode of the original
+		(list->borrowed == NULL) // compacting copied every string it had borrowed
+	);
+
+	listDestroy(list);
+	listDestroy(clone);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_new_inline() {
+	announce_test("list_new_inline");
+
+	StringList* list = listNewInline(2);
+	listAdd(list, "short");
+	listAdd(list, "a string that is too long to fit in a cell");
+	for (int i = 0; i < 30; i++) { // grow well past the initial cell block
+		listAdd(list, "abc");
+	}
+	listInsert(list, 1, "inserted");
+	listSet(list, 0, "also a string that is too long for a cell");
+	listSet(list, 2, "now short");
+	listRemoveRange(list, 4, 30);
+
+	StringList* expected = listNew();
+	listAdd(expected, "also a string that is too long for a cell");
+	listAdd(expected, "inserted");
+	listAdd(expected, "now short");
+	for (int i = 0; i < 4; i++) {
+		listAdd(expected, "abc");
+	}
+
+	bool result_a = listEquals(list, expected);
+
+	listTrimCapacity(list); // shrinking relocates inline strings that sit in dropped cells
+
+	bool result = (
+		result_a &&
+		listEquals(list, expected) &&
+		(listCapacity(list) == 7)
+	);
+
+	listDestroy(list);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_enable_index() {
+	announce_test("list_enable_index");
+
+	const char *keys[] = { "a", "b", "c", "d", "e", "f", "g" };
+	int key_count = sizeof(keys) / sizeof(keys[0]);
+
+	StringList* plain = listNew();
+	StringList* indexed = listNew();
+	listEnableIndex(indexed);
+
+	bool result = true;
+	srand(1);
+	for (int step = 0; step < 2000 && result; step++) {
+		const char *key = keys[rand() % key_count];
+		int length = listLength(plain);
+		int op = rand() % 6;
+
+		// apply the same mutation to both lists
+		if ((op == 0) || (length == 0)) {
+			listAdd(plain, key);
+			listAdd(indexed, key);
+		} else if (op == 1) {
+			int index = rand() % length;
+			listSet(plain, index, key);
+			listSet(indexed, index, key);
+		} else if (op == 2) {
+			int index = rand() % length;
+			listInsert(plain, index, key);
+			listInsert(indexed, index, key);
+		} else if (op == 3) {
+			int index = ((step % 3) == 0) ? 0 : (rand() % length); // front removals only move the base
+			listRemove(plain, index);
+			listRemove(indexed, index);
+		} else if (op == 4) {
+			listRemoveElement(plain, key);
+			listRemoveElement(indexed, key);
+		} else if ((step % 2) == 0) {
+			listRemoveElements(plain, key);
+			listRemoveElements(indexed, key);
+		} else {
+			int index = rand() % length;
+			int to = (index + 2 < length) ? (index + 2) : length;
+			listRemoveRange(plain, index, to);
+			listRemoveRange(indexed, index, to);
+		}
+
+		// every lookup must agree with the linear scan
+		for (int k = 0; k < key_count; k++) {
+			result = result && (
+				(listIndexOf(plain, keys[k]) == listIndexOf(indexed, keys[k])) &&
+				(listLastIndexOf(plain, keys[k]) == listLastIndexOf(indexed, keys[k])) &&
+				(listContains(plain, keys[k]) == listContains(indexed, keys[k]))
+			);
+		}
+	}
+
+	listClear(indexed);
+	result = (
+		result &&
+		!listContains(indexed, "a") &&
+		(indexed->index != NULL)
+	);
+
+	listDestroy(plain);
+	listDestroy(indexed);
+
+	return result;
+}
+
+bool test_retain_all() {
+	announce_test("list_retain_all");
+
+	StringList* list = listNew();
+	listAdd(list, "a");
+	listAdd(list, "b");
+	listAdd(list, "c");
+	listAdd(list, "a");
+
+	StringList* to_keep = listNew(); // larger than 'list' so the set is built over 'list'
+	listAdd(to_keep, "x");
+	listAdd(to_keep, "a");
+	listAdd(to_keep, "y");
+	listAdd(to_keep, "c");
+	listAdd(to_keep, "z");
+
+	listRetainAll(list, to_keep);
+
+	StringList* expected = listNew();
+	listAdd(expected, "a");
+	listAdd(expected, "c");
+	listAdd(expected, "a");
+
+	bool result = listEquals(list, expected);
+
+	listDestroy(list);
+	listDestroy(to_keep);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_set_operations() {
+	announce_test("list_set_operations");
+
+	StringList* list_a = listNew();
+	listAdd(list_a, "a");
+	listAdd(list_a, "b");
+	listAdd(list_a, "c");
+	listAdd(list_a, "b");
+
+	StringList* list_b = listNew();
+	listAdd(list_b, "b");
+	listAdd(list_b, "d");
+
+	StringList* intersection = listIntersection(list_a, list_b);
+	StringList* difference = listDifference(list_a, list_b);
+	StringList* list_union = listUnion(list_a, list_b);
+
+	StringList* expected_intersection = listNew();
+	listAdd(expected_intersection, "b");
+	listAdd(expected_intersection, "b");
+
+	StringList* expected_difference = listNew();
+	listAdd(expected_difference, "a");
+	listAdd(expected_difference, "c");
+
+	StringList* expected_union = listNew();
+	listAdd(expected_union, "a");
+	listAdd(expected_union, "b");
+	listAdd(expected_union, "c");
+	listAdd(expected_union, "b");
+	listAdd(expected_union, "d");
+
+	bool result = (
+		listEquals(intersection, expected_intersection) &&
+		listEquals(difference, expected_difference) &&
+		listEquals(list_union, expected_union)
+	);
+
+	listDestroy(list_a);
+	listDestroy(list_b);
+	listDestroy(intersection);
+	listDestroy(difference);
+	listDestroy(list_union);
+	listDestroy(expected_intersection);
+	listDestroy(expected_difference);
+	listDestroy(expected_union);
+
+	return result;
+}
+
+/* order strings by length only, so equal-length strings test stability */
+int compare_length(const char * a, const char * b) {
+	return (int) strlen(a) - (int) strlen(b);
+}
+
+bool test_sort() {
+	announce_test("list_sort");
+
+	StringList* list = listNew();
+	for (int i = 0; i < 100; i++) { // enough elements to need several merge passes
+		char buffer[8];
+		snprintf(buffer, sizeof(buffer), "%d", (i * 37) % 100);
+		listAdd(list, buffer);
+	}
+
+	listSort(list, &compare_length);
+
+	// one-digit numbers first, then two-digit ones, each group in insertion order
+	bool result = true;
+	for (int i = 1; i < listLength(list); i++) {
+		int length_a = strlen(listGet(list, (i - 1)));
+		int length_b = strlen(listGet(list, i));
+		result = result && (length_a <= length_b);
+	}
+	result = (
+		result &&
+		(strcmp(listGet(list, 0), "0") == 0) &&
+		(strcmp(listGet(list, 1), "7") == 0) && // 37 * 11 = 407
+		(strcmp(listGet(list, 10), "37") == 0)
+	);
+
+	listDestroy(list);
+
+	return result;
+}
+
+int compare_qsort(const void * a, const void * b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+bool test_sort_lexicographic() {
+	announce_test("list_sort_lexicographic");
+
+	StringList* list = listNew();
+	char *expected[5000]; // enough to take the radix path as well as the quicksort one
+
+	srand(2);
+	for (int i = 0; i < 5000; i++) {
+		char buffer[12];
+		int length = rand() % 10;
+		for (int c = 0; c < length; c++) {
+			buffer[c] = "aab\xe9z"[rand() % 5]; // few distinct bytes so prefixes are shared, one non-ascii
+		}
+		buffer[length] = '\0';
+		listAdd(list, buffer);
+		expected[i] = listGet(list, i);
+	}
+
+	qsort(expected, 5000, sizeof(char *), &compare_qsort);
+	listSortLexicographic(list);
+
+	bool result = true;
+	for (int i = 0; i < 5000; i++) {
+		result = result && (strcmp(listGet(list, i), expected[i]) == 0);
+	}
+
+	// thousands of bytes shared by every string must not take a stack frame each
+	StringList* prefixed = listNew();
+	char *buffer = malloc(5001);
+	memset(buffer, 'a', 5000);
+	buffer[5000] = '\0';
+	for (int i = 0; i < 5000; i++) {
+		buffer[4999] = "cab"[i % 3];
+		listAdd(prefixed, buffer);
+	}
+	free(buffer);
+	listSortLexicographic(prefixed);
+	for (int i = 1; i < 5000; i++) {
+		result = result && (strcmp(listGet(prefixed, (i - 1)), listGet(prefixed, i)) <= 0);
+	}
+	result = result && (listGet(prefixed, 0)[4999] == 'a') && (listGet(prefixed, 4999)[4999] == 'c');
+
+	listDestroy(list);
+	listDestroy(prefixed);
+
+	return result;
+}
+
+bool test_sort_parallel() {
+	announce_test("list_sort_parallel");
+
+	StringList* list = listNew();
+	srand(3);
+	for (int i = 0; i < 3000; i++) {
+		char buffer[8];
+		snprintf(buffer, sizeof(buffer), "%d", rand() % 100000);
+		listAdd(list, buffer);
+	}
+
+	bool result = true;
+	int thread_counts[] = { 1, 2, 3, 7, 64 }; // odd counts leave a run without a partner
+	for (int t = 0; t < 5; t++) {
+		StringList* serial = listClone(list);
+		StringList* parallel = listClone(list);
+
+		// length order has many ties, so only a stable sort matches the serial result
+		listSort(serial, &compare_length);
+		listSortParallel(parallel, &compare_length, thread_counts[t]);
+
+		result = result && listEquals(serial, parallel);
+
+		listDestroy(serial);
+		listDestroy(parallel);
+	}
+
+	listDestroy(list);
+
+	return result;
+}
+
+bool test_sorted_insert() {
+	announce_test("list_sorted_insert");
+
+	StringList* list = listNewSorted(4, &strcmp);
+	listSortedInsert(list, "m");
+	listSortedInsert(list, "c");
+	listSortedInsert(list, "x");
+	listSortedInsert(list, "a");
+	listSortedInsert(list, "m");
+
+	StringList* expected = listNew();
+	listAdd(expected, "a");
+	listAdd(expected, "c");
+	listAdd(expected, "m");
+	listAdd(expected, "m");
+	listAdd(expected, "x");
+
+	bool result_a = (
+		listEquals(list, expected) &&
+		(list->sorted_by == &strcmp)
+	);
+
+	listAdd(list, "b"); // an unordered write drops the sorted flag
+
+	bool result = (
+		result_a &&
+		(list->sorted_by == NULL)
+	);
+
+	listDestroy(list);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_binary_search() {
+	announce_test("list_binary_search");
+
+	StringList* list = listNew();
+	listAdd(list, "d");
+	listAdd(list, "b");
+	listAdd(list, "f");
+	listAdd(list, "b");
+	listAdd(list, "a");
+
+	listSortLexicographic(list); // a, b, b, d, f
+
+	bool result = (
+		(listBinarySearch(list, "b") == 1) &&
+		(listBinarySearch(list, "c") == -1) &&
+		(listLowerBound(list, "b") == 1) &&
+		(listUpperBound(list, "b") == 3) &&
+		(listLowerBound(list, "c") == 3) &&
+		(listUpperBound(list, "z") == 5) &&
+		(listLowerBound(list, "") == 0) &&
+		(listIndexOf(list, "d") == 3) &&
+		(listLastIndexOf(list, "b") == 2) &&
+		(listIndexOf(list, "e") == -1) &&
+		(listLastIndexOf(list, "0") == -1)
+	);
+
+	listRemove(list, 0); // removals keep the order
+
+	result = (
+		result &&
+		(listBinarySearch(list, "d") == 2)
+	);
+
+	listDestroy(list);
+
+	return result;
+}
+
+bool test_enable_metadata() {
+	announce_test("list_enable_metadata");
+
+	const char *keys[] = { "ab", "ba", "abc", "", "b", "abcd" }; // same-length keys that differ
+	int key_count = sizeof(keys) / sizeof(keys[0]);
+
+	StringList* plain = listNewCapacity(1);
+	StringList* tagged = listNewCapacity(1);
+	listEnableMetadata(tagged);
+
+	bool result = true;
+	srand(4);
+	for (int step = 0; step < 1000 && result; step++) {
+		const char *key = keys[rand() % key_count];
+		int length = listLength(plain);
+		int op = rand() % 6;
+
+		if ((op <= 1) || (length == 0)) {
+			listAdd(plain, key);
+			listAdd(tagged, key);
+		} else if (op == 2) {
+			int index = rand() % length;
+			listInsert(plain, index, key);
+			listInsert(tagged, index, key);
+		} else if (op == 3) {
+			int index = rand() % length;
+			listSet(plain, index, key);
+			listSet(tagged, index, key);
+		} else if (op == 4) {
+			listRemoveElements(plain, key);
+			listRemoveElements(tagged, key);
+		} else if ((step % 20) == 0) {
+			listSortLexicographic(plain);
+			listSortLexicographic(tagged);
+		} else if ((step % 10) == 0) {
+			listSort(plain, &strcmp);
+			listSort(tagged, &strcmp);
+		} else {
+			listClear(plain);
+			listClear(tagged);
+		}
+
+		for (int k = 0; k < key_count; k++) {
+			result = result && (
+				(listIndexOf(plain, keys[k]) == listIndexOf(tagged, keys[k])) &&
+				(listLastIndexOf(plain, keys[k]) == listLastIndexOf(tagged, keys[k]))
+			);
+		}
+		result = result && listEquals(plain, tagged);
+	}
+
+	listAdd(tagged, "last");
+	StringList* clone = listClone(tagged);
+	listSet(clone, 0, "different");
+
+	result = (
+		result &&
+		(clone->hashes != NULL) &&
+		listEquals(tagged, tagged) &&
+		!listEquals(clone, tagged)
+	);
+
+	// the sorts carry each element's hash and length along, a stale entry would hide the element
+	StringList* sorted = listNew();
+	listEnableMetadata(sorted);
+	for (int i = 0; i < 5000; i++) {
+		char buffer[8];
+		snprintf(buffer, sizeof(buffer), "%d", ((i * 7919) % 5000));
+		listAdd(sorted, buffer);
+	}
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 0) {
+			listSortParallel(sorted, &strcmp, 4);
+		} else {
+			listSortLexicographic(sorted); // past the radix cutoff
+		}
+		listAdd(sorted, "unsorted"); // so lookups scan the metadata instead of binary searching
+		for (int i = 0; (i < listLength(sorted)) && result; i++) {
+			result = (listIndexOf(sorted, listGet(sorted, i)) == i);
+		}
+		listRemove(sorted, (listLength(sorted) - 1));
+	}
+
+	listDestroy(plain);
+	listDestroy(tagged);
+	listDestroy(clone);
+	listDestroy(sorted);
+
+	return result;
+}
+
+bool test_search_kernel() {
+	announce_test("list_search_kernel");
+
+	StringList* list = listNew();
+	listEnableMetadata(list);
+	for (int i = 0; i < 100; i++) { // long enough to exercise full vector blocks and the scalar tail
+		char buffer[8];
+		snprintf(buffer, sizeof(buffer), "%d", (i % 30));
+		listAdd(list, buffer);
+	}
+
+	bool result = (
+		(listSearchKernel() != NULL) &&
+		(listIndexOf(list, "0") == 0) &&
+		(listIndexOf(list, "29") == 29) &&
+		(listLastIndexOf(list, "9") == 99) &&
+		(listLastIndexOf(list, "0") == 90) &&
+		(listLastIndexOf(list, "10") == 70) &&
+		(listIndexOf(list, "30") == -1) &&
+		(listLastIndexOf(list, "30") == -1)
+	);
+
+	listRemoveElements(list, "5");
+	listRemoveElements(list, "0");
+
+	result = (
+		result &&
+		(listLength(list) == 92) &&
+		!listContains(list, "5") &&
+		(listIndexOf(list, "1") == 0) &&
+		(listIndexOf(list, "6") == 4) &&
+		(listLastIndexOf(list, "9") == 91)
+	);
+
+	listDestroy(list);
+
+	return result;
+}
+
+bool test_parallel_scans() {
+	announce_test("list_parallel_scans");
+
+	StringList* list = listNew();
+	for (int i = 0; i < 200000; i++) { // large enough to be split across threads
+		char buffer[16];
+		snprintf(buffer, sizeof(buffer), "%c%d", "abc"[i % 3], i);
+		listAdd(list, buffer);
+	}
+	StringList* serial = listClone(list);
+	StringList* tagged = listClone(list);
+	listEnableMetadata(tagged);
+
+	bool result = (
+		(listParallelIndexOf(list, "c150002", 4) == 150002) &&
+		(listParallelIndexOf(tagged, "b100", 4) == 100) &&
+		(listParallelIndexOf(list, "a1", 4) == -1) &&
+		(listParallelCount(list, &conditional_funct, 4) == listParallelCount(list, &conditional_funct, 1)) &&
+		listParallelEquals(list, serial, 4) &&
+		listParallelEquals(list, tagged, 3)
+	);
+
+	listSet(serial, 199999, "changed");
+	result = result && !listParallelEquals(list, serial, 4);
+	listSet(serial, 199999, listGet(list, 199999));
+
+	listParallelRemoveIf(list, &conditional_funct, 4);
+	listParallelRemoveIf(tagged, &conditional_funct, 3);
+	listRemoveIf(serial, &conditional_funct);
+
+	result = (
+		result &&
+		(listLength(list) == 66667) && // only the "b" elements survive
+		listEquals(list, serial) &&
+		listEquals(tagged, serial) &&
+		(listIndexOf(tagged, "b199999") == 66666)
+	);
+
+	listDestroy(list);
+	listDestroy(serial);
+	listDestroy(tagged);
+
+	return result;
+}
+
+bool test_queue() {
+	announce_test("list_queue");
+
+	StringList* list = listNew();
+	listEnableMetadata(list);
+
+	// use the list as a FIFO queue: add at the back, remove at the front
+	char buffer[16];
+	int next_in = 0;
+	int next_out = 0;
+	bool result = true;
+	for (int round = 0; round < 50; round++) {
+		for (int i = 0; i < 30; i++) {
+			snprintf(buffer, sizeof(buffer), "%d", next_in++);
+			listAdd(list, buffer);
+		}
+		for (int i = 0; i < 25; i++) {
+			snprintf(buffer, sizeof(buffer), "%d", next_out++);
+			result = result && (strcmp(listGet(list, 0), buffer) == 0);
+			listRemove(list, 0);
+		}
+	}
+
+	// front removals leave head room instead of shifting every element
+	int capacity = listCapacity(list);
+	listRemove(list, 0);
+	listAdd(list, "1500");
+	result = (
+		result &&
+		(listCapacity(list) == capacity) && // the allocation, whatever part of it the elements use
+		(listLength(list) == 250) &&
+		(list->head > 0) &&
+		(listIndexOf(list, "1251") == 0) &&
+		(listLastIndexOf(list, "1500") == 249)
+	);
+
+	listTrimCapacity(list);
+
+	result = (
+		result &&
+		(list->head == 0) &&
+		(listCapacity(list) == 250) &&
+		(strcmp(listGet(list, 0), "1251") == 0) &&
+		(listIndexOf(list, "1500") == 249)
+	);
+
+	listDestroy(list);
+
+	return result;
+}
+
+bool test_insert_front() {
+	announce_test("list_insert_front");
+
+	StringList* list = listNew();
+	StringList* expected = listNew();
+	listAdd(list, "end");
+
+	char buffer[16];
+	for (int i = 0; i < 100; i++) { // inserting at the front reuses head room
+		snprintf(buffer, sizeof(buffer), "%d", i);
+		listInsert(list, 0, buffer);
+	}
+	listInsert(list, 10, "middle");
+
+	for (int i = 99; i >= 0; i--) {
+		snprintf(buffer, sizeof(buffer), "%d", i);
+		listAdd(expected, buffer);
+	}
+	listAdd(expected, "end");
+	listInsert(expected, 10, "middle");
+
+	bool result = listEquals(list, expected);
+
+	listRemoveRange(list, 1, 5); // front-heavy ranges move the front instead of the tail
+	listRemoveRange(expected, 1, 5);
+
+	result = (
+		result &&
+		listEquals(list, expected)
+	);
+
+	listClear(list);
+
+	result = (
+		result &&
+		(list->head == 0)
+	);
+
+	listDestroy(list);
+	listDestroy(expected);
+
+	return result;
+}
+
+bool test_tiered_list() {
+	announce_test("tiered_list");
+
+	StringList* expected = listNew();
+	TieredStringList* tiered = tieredListNew();
+
+	// grow past a few chunk size rebuilds while mixing inserts and removals everywhere
+	srand(13);
+	char buffer[16];
+	for (int i = 0; i < 6000; i++) {
+		snprintf(buffer, sizeof(buffer), "%d", i);
+		int index = rand() % (listLength(expected) + 1);
+		if (index == listLength(expected)) {
+			listAdd(expected, buffer); // listInsert doesn't append
+		} else {
+			listInsert(expected, index, buffer);
+		}
+		tieredListInsert(tiered, index, buffer);
+
+		if ((i % 3) == 0) {
+			index = rand() % listLength(expected);
+			listRemove(expected, index);
+			tieredListRemove(tiered, index);
+		}
+	}
+	tieredListSet(tiered, 7, "seven");
+	listSet(expected, 7, "seven");
+
+	StringList* converted = tieredListToList(tiered);
+
+	bool result = (
+		(tieredListLength(tiered) == listLength(expected)) &&
+		listEquals(converted, expected) &&
+		(strcmp(tieredListGet(tiered, 7), "seven") == 0) &&
+		(tieredListIndexOf(tiered, "seven") == 7) &&
+		(tieredListIndexOf(tiered, "missing") == -1)
+	);
+
+	while (tieredListLength(tiered) > 0) {
+		tieredListRemove(tiered, 0);
+	}
+	tieredListAdd(tiered, "again");
+
+	TieredStringList* copy = tieredListFromList(expected);
+	StringList* round_trip = tieredListToList(copy);
+
+	result = (
+		result &&
+		(tieredListLength(tiered) == 1) &&
+		(strcmp(tieredListGet(tiered, 0), "again") == 0) &&
+		listEquals(round_trip, expected)
+	);
+
+	listDestroy(expected);
+	listDestroy(converted);
+	listDestroy(round_trip);
+	tieredListDestroy(tiered);
+	tieredListDestroy(copy);
+
+	return result;
+}
+
+// a malloc'd copy of 'value', for the functions that take ownership of a buffer
+char *heap_string(const char *value) {
+	char *buffer = malloc(strlen(value) + 1);
+	strcpy(buffer, value);
+	return buffer;
+}
+
+bool test_owned() {
+	announce_test("list_owned");
+
+	StringList* list = listNew();
+	listEnableIndex(list);
+
+	char *first = heap_string("1");
+	char *second = heap_string("2");
+	listAddOwned(list, first);
+	listAddOwned(list, second);
+	listInsertOwned(list, 1, heap_string("between"));
+	listSetOwned(list, 2, heap_string("3"));
+
+	bool result = (
+		(listGet(list, 0) == first) && // adopted, not copied
+		(listLength(list) == 3) &&
+		(strcmp(listGet(list, 1), "between") == 0) &&
+		(strcmp(listGet(list, 2), "3") == 0)
+	);
+
+	char *taken = listTake(list, 0);
+	result = (
+		result &&
+		(taken == first) &&
+		(listLength(list) == 2) &&
+		!listContains(list, "1") &&
+		(listIndexOf(list, "3") == 1)
+	);
+	free(taken);
+
+	// arena lists copy adopted strings in, and hand taken ones back as heap copies
+	StringList* arena = listNewArena(2, 64);
+	listAddOwned(arena, heap_string("a"));
+	listAddOwned(arena, heap_string("b"));
+	listAddOwned(arena, heap_string("c"));
+	taken = listTake(arena, 1);
+
+	result = (
+		result &&
+		(strcmp(taken, "b") == 0) &&
+		(listLength(arena) == 2) &&
+		(strcmp(listGet(arena, 1), "c") == 0)
+	);
+	free(taken);
+
+	listDestroy(list);
+	listDestroy(arena);
+
+	return result;
+}
+
+bool test_move_all() {
+	announce_test("list_move_all");
+
+	StringList* dst = listNewCapacity(1);
+	listAdd(dst, "1");
+	StringList* src = listNew();
+	listAdd(src, "2");
+	listAdd(src, "3");
+	listEnableMetadata(src);
+	listRemove(src, 0); // leaves head room in 'src'
+	listAdd(src, "4");
+
+	char *moved = listGet(src, 0);
+	listEnableIndex(dst);
+	listMoveAll(dst, src);
+
+	StringList* expected = listNew();
+	listAdd(expected, "1");
+	listAdd(expected, "3");
+	listAdd(expected, "4");
+
+	bool result = (
+		listEquals(dst, expected) &&
+		(listGet(dst, 1) == moved) && // the pointer itself moved
+		(listIndexOf(dst, "4") == 2) &&
+		listIsEmpty(src)
+	);
+
+	// 'src' stays usable, and inline storage falls back to copying
+	listAdd(src, "5");
+	StringList* cells = listNewInline(2);
+	listAdd(cells, "6");
+	listMoveAll(src, cells);
+
+	result = (
+		result &&
+		(listLength(src) == 2) &&
+		(strcmp(listGet(src, 1), "6") == 0) &&
+		listIsEmpty(cells)
+	);
+
+	listDestroy(dst);
+	listDestroy(src);
+	listDestroy(expected);
+	listDestroy(cells);
+
+	return result;
+}
+
+bool test_view() {
+	announce_test("list_view");
+
+	StringList* list = listNew();
+	listAdd(list, "1");
+	listAdd(list, "2");
+	listAdd(list, "3");
+	listAdd(list, "2");
+	listAdd(list, "1");
+
+	StringListView middle = listView(list, 1, 4);
+	StringListView tail = listView(list, 3, 5);
+
+	StringList* other = listNew();
+	listAdd(other, "2");
+	listAdd(other, "1");
+	listEnableMetadata(other);
+
+	bool result = (
+		(viewLength(middle) == 3) &&
+		(viewGet(middle, 0) == listGet(list, 1)) && // borrowed, not copied
+		(viewIndexOf(middle, "2") == 0) &&
+		(viewLastIndexOf(middle, "2") == 2) &&
+		(viewIndexOf(middle, "1") == -1) &&
+		viewContains(tail, "1") &&
+		!viewContains(tail, "3") &&
+		viewEquals(tail, listView(other, 0, 2)) &&
+		!viewEquals(tail, listView(list, 0, 2)) &&
+		(viewLength(listView(list, 2, 2)) == 0)
+	);
+
+	listEnableIndex(list);
+	result = (
+		result &&
+		(viewIndexOf(middle, "3") == 1) &&
+		(viewIndexOf(middle, "missing") == -1)
+	);
+
+	listDestroy(list);
+	listDestroy(other);
+
+	return result;
+}
+
+// clones the shared list over and over, reading each clone before dropping it
+void *clone_concurrently(void *arg) {
+	const StringList *source = arg;
+	for (int i = 0; i < 1000; i++) {
+		StringList *clone = listClone(source);
+		if ((clone == NULL) || (listIndexOf(clone, "3") != 1)) {
+			return arg; // any non-NULL result reports the failure
+		}
+		listDestroy(clone);
+	}
+	return NULL;
+}
+
+bool test_clone_shared() {
+	announce_test("list_clone_shared");
+
+	StringList* list = listNew();
+	listAdd(list, "1");
+	listAdd(list, "2");
+	listAdd(list, "3");
+	listEnableIndex(list);
+	listRemove(list, 0); // moves the index positions
+
+	// cloning only bumps a count, so any number of threads may clone the same list at once
+	bool result = true;
+	pthread_t threads[4];
+	for (int t = 0; t < 4; t++) {
+		pthread_create(&threads[t], NULL, &clone_concurrently, list);
+	}
+	for (int t = 0; t < 4; t++) {
+		void *failed;
+		pthread_join(threads[t], &failed);
+		result = result && (failed == NULL);
+	}
+
+	StringList* clone = listClone(list);
+	StringList* second = listClone(clone);
+
+	result = (
+		result &&
+		(clone->list == list->list) && // no copy yet
+		(second->list == list->list) &&
+		(listIndexOf(clone, "3") == 1)
+	);
+
+	// writes copy the writer's slots only, the strings it keeps stay shared
+	listAdd(clone, "4");
+	listSet(list, 0, "two");
+
+	result = (
+		result &&
+		(clone->list != second->list) &&
+		(list->list != second->list) &&
+		(listGet(clone, 0) == listGet(second, 0)) &&
+		(listGet(list, 1) == listGet(second, 1)) &&
+		(strcmp(listGet(second, 0), "2") == 0) &&
+		(listLength(second) == 2) &&
+		(listIndexOf(clone, "4") == 2) &&
+		(strcmp(listGet(list, 0), "two") == 0)
+	);
+
+	// once every other holder is gone, a write takes the storage over without copying
+	StringList* last = listSublist(second, 0, 2);
+	StringList* other = listClone(last);
+	char **slots = last->list;
+	listDestroy(other);
+	listRemove(last, 0);
+
+	result = (
+		result &&
+		(last->list == (slots + 1)) &&
+		(listLength(last) == 1) &&
+		(strcmp(listGet(last, 0), "3") == 0)
+	);
+
+	// clearing a shared list copies nothing and leaves the other holder intact
+	StringList* cleared = listClone(clone);
+	listClear(cleared);
+	listAdd(cleared, "5");
+
+	result = (
+		result &&
+		(listLength(clone) == 3) &&
+		(listLength(cleared) == 1)
+	);
+
+	// the borrowed strings outlive the list they came from, until the borrower replaces them
+	StringList* borrower = listClone(second);
+	listSet(borrower, 0, "new");
+	listDestroy(second);
+	result = result && (strcmp(listGet(borrower, 1), "3") == 0) && (borrower->borrowed != NULL);
+	for (int i = 0; i < 100; i++) { // the borrower's own strings, freed and taken like any others
+		char buffer[8];
+		snprintf(buffer, sizeof(buffer), "%d", i);
+		listAdd(borrower, buffer);
+	}
+	for (int i = 0; i < 50; i++) {
+		listRemove(borrower, 2);
+	}
+	char *own = listTake(borrower, 2);
+	result = result && (strcmp(own, "50") == 0) && (strcmp(listGet(borrower, 1), "3") == 0) && (borrower->borrowed != NULL);
+	free(own);
+	listSet(borrower, 1, "newer"); // the last borrowed string is gone, and with it the old storage
+	result = (
+		result &&
+		(borrower->borrowed == NULL) &&
+		(listLength(borrower) == 51) &&
+		(strcmp(listGet(borrower, 0), "new") == 0) &&
+		(strcmp(listGet(borrower, 50), "99") == 0)
+	);
+
+	// arena and inline clones borrow the same way, a taken borrowed element comes back as a copy
+	for (int kind = 0; kind < 2; kind++) {
+		StringList* stored = (kind == 0) ? listNewArena(4, 64) : listNewInline(4);
+		listAdd(stored, "x");
+		listAdd(stored, "y");
+		StringList* copy = listClone(stored);
+		listAdd(copy, "z");
+		char *taken = listTake(copy, 0);
+		listDestroy(stored);
+		result = (
+			result &&
+			(strcmp(taken, "x") == 0) &&
+			(strcmp(listGet(copy, 0), "y") == 0) &&
+			(strcmp(listGet(copy, 1), "z") == 0)
+		);
+		free(taken);
+		listDestroy(copy);
+	}
+
+	// a holder left alone after the other one moved off with nothing changes the storage in place
+	StringList* alone = listNew();
+	listAdd(alone, "x");
+	listEnableIndex(alone);
+	StringList* gone = listClone(alone);
+	listClear(gone);
+	listDisableIndex(alone);
+	result = result && (alone->index == NULL) && (strcmp(listGet(alone, 0), "x") == 0);
+	listDestroy(alone);
+	listDestroy(gone);
+
+	alone = listNew();
+	StringList* target = listNew();
+	listAdd(alone, "x");
+	gone = listClone(alone);
+	listClear(alone);
+	listMoveAll(target, gone); // 'gone' is the only holder left, its strings move to 'target'
+	listDestroy(gone);
+	result = result && (listLength(target) == 1) && (strcmp(listGet(target, 0), "x") == 0);
+	listDestroy(alone);
+	listDestroy(target);
+
+	listDestroy(list);
+	listDestroy(clone);
+	listDestroy(last);
+	listDestroy(cleared);
+	listDestroy(borrower);
+
+	return result;
+}
+
+bool test_capacity_policy() {
+	announce_test("list_capacity_policy");
+
+	StringList* list = listNewCapacity(10);
+	listSetGrowthPolicy(list, 1.5, 100);
+
+	for (int i = 0; i < 11; i++) {
+		listAdd(list, "x");
+	}
+	bool result = (listCapacity(list) == 16); // 10 * 1.5 + 1
+
+	for (int i = 0; i < 190; i++) {
+		listAdd(list, "x");
+	}
+	int grown = listCapacity(list);
+	listAdd(list, "x");
+	while (listLength(list) < listCapacity(list)) {
+		listAdd(list, "x");
+	}
+	listAdd(list, "x");
+	result = result && (listCapacity(list) <= (grown + 200)); // capped steps past the first growth
+
+	// drain the list: it shrinks once well under a quarter full, not on every removal
+	listSetGrowthPolicy(list, 2.0, 0);
+	listSetShrinkPolicy(list, 0.25);
+	int peak = listCapacity(list);
+	while (listLength(list) > (peak / 4)) {
+		listRemove(list, 0);
+	}
+	result = result && (listCapacity(list) == peak) && (list->head > 0); // the head room still counts
+
+	listRemove(list, 0);
+	int shrunk = listCapacity(list);
+	result = (
+		result &&
+		(shrunk < peak) &&
+		(shrunk > listLength(list))
+	);
+
+	listRemoveRange(list, 0, listLength(list));
+	result = result && (listCapacity(list) == 16); // the floor
+
+	// a reservation survives removals
+	listEnsureCapacity(list, 500);
+	listAdd(list, "x");
+	listRemove(list, 0);
+	result = result && (listCapacity(list) == 500);
+
+	// bulk adds reserve once
+	StringList* bulk = listNewCapacity(0);
+	listAddAll(bulk, list);
+	StringList* many = listNewCapacity(1000);
+	for (int i = 0; i < 1000; i++) {
+		listAdd(many, "y");
+	}
+	listAddAll(bulk, many);
+	result = result && (listCapacity(bulk) == 1000) && (listLength(bulk) == 1000);
+
+	listDestroy(list);
+	listDestroy(bulk);
+	listDestroy(many);
+
+	return result;
+}
+
+// allocator callbacks that count the blocks a list holds
+typedef struct {
+	int allocations;
+	int outstanding;
+} AllocationCount;
+
+void *counting_alloc(void *context, size_t size) {
+	AllocationCount *count = context;
+	count->allocations++;
+	count->outstanding++;
+	return malloc(size);
+}
+
+void *counting_realloc(void *context, void *block, size_t size) {
+	AllocationCount *count = context;
+	count->allocations++;
+	assert(block != NULL); // new blocks always come from counting_alloc
+	return realloc(block, size);
+}
+
+void counting_free(void *context, void *block) {
+	AllocationCount *count = context;
+	count->outstanding--;
+	free(block);
+}
+
+// malloc-backed allocator that refuses every request while '*context' is true
+void *failing_alloc(void *context, size_t size) {
+	return *(bool *) context ? NULL : malloc(size);
+}
+
+void *failing_realloc(void *context, void *block, size_t size) {
+	return *(bool *) context ? NULL : realloc(block, size);
+}
+
+void failing_free(void *context, void *block) {
+	free(block);
+}
+
+// malloc-backed allocator that grants '*context' more requests and then refuses them, negative for no limit
+bool rationed_grant(int *left) {
+	if (*left == 0) {
+		return false;
+	}
+	if (*left > 0) {
+		(*left)--;
+	}
+	return true;
+}
+
+void *rationed_alloc(void *context, size_t size) {
+	return rationed_grant(context) ? malloc(size) : NULL;
+}
+
+void *rationed_realloc(void *context, void *block, size_t size) {
+	return rationed_grant(context) ? realloc(block, size) : NULL;
+}
+
+bool test_failed_insert() {
+	announce_test("failed_insert");
+
+	bool fail = false;
+	ListAllocator allocator = { &failing_alloc, &failing_realloc, &failing_free, &fail };
+	StringList* list = listNewWithAllocator(3, &allocator);
+	listAdd(list, "a");
+	listAdd(list, "b");
+
+	fail = true;
+	bool result = (
+		(listInsert(list, 1, "c") == NULL) && // the slot opens, then copying "c" fails
+		(listSet(list, 0, "c") == NULL) &&
+		(listAdd(list, "c") == NULL) && // there is room, only the copy fails
+		(listLength(list) == 2) &&
+		(strcmp(listGet(list, 0), "a") == 0) &&
+		(strcmp(listGet(list, 1), "b") == 0)
+	);
+
+	fail = false;
+	listSet(list, 1, listGet(list, 1)); // the new value is copied before the old one is released
+	result = result && (strcmp(listGet(list, 1), "b") == 0);
+	listAdd(list, "c");
+	fail = true;
+	char *value = malloc(2);
+	strcpy(value, "d");
+	result = (
+		result &&
+		(listAddOwned(list, value) == NULL) && // the list is full and cannot grow
+		(listLength(list) == 3) &&
+		(strcmp(listGet(list, 2), "c") == 0)
+	);
+	free(value); // still the caller's after a failed add
+
+	fail = false;
+	listDestroy(list);
+
+	// growing fails after the hashes array was resized but before the lengths array was
+	int left = -1;
+	ListAllocator rationed = { &rationed_alloc, &rationed_realloc, &failing_free, &left };
+	list = listNewWithAllocator(2, &rationed);
+	listEnableMetadata(list);
+	listAdd(list, "a");
+	listAdd(list, "b");
+	left = 1;
+	result = result && (listSetCapacity(list, 64) == NULL) && (listCapacity(list) == 2);
+	left = -1;
+	for (int i = 0; i < 64; i++) {
+		listAdd(list, "c");
+	}
+	result = result && (listLength(list) == 66) && (listIndexOf(list, "b") == 1);
+	listDestroy(list);
+
+	// a bulk insert that runs out of memory partway gives back its copies and closes the gap
+	list = listNewWithAllocator(8, &rationed);
+	StringList* src = listNew();
+	const char *values[] = { "a", "b", "c" };
+	for (int i = 0; i < 3; i++) {
+		listAdd(list, values[i]);
+		listAdd(src, values[i]); // keys the index already has, so only the copies allocate
+	}
+	listEnableIndex(list);
+	left = 1;
+	result = (
+		result &&
+		(listInsertAll(list, 1, src) == NULL) &&
+		(listLength(list) == 3) &&
+		(strcmp(listGet(list, 1), "b") == 0) &&
+		(strcmp(listGet(list, 2), "c") == 0) &&
+		(listIndexOf(list, "a") == 0) &&
+		(listLastIndexOf(list, "a") == 0) &&
+		(listLastIndexOf(list, "c") == 2)
+	);
+	left = -1;
+	listDestroy(list);
+	listDestroy(src);
+
+	// a move that has to copy and runs out of memory partway leaves both lists as they were
+	list = listNewWithAllocator(8, &rationed);
+	listAdd(list, "a");
+	src = listNewArena(4, 64);
+	for (int i = 0; i < 3; i++) {
+		listAdd(src, values[i]);
+	}
+	left = 1;
+	result = (
+		result &&
+		(listMoveAll(list, src) == NULL) &&
+		(listLength(list) == 1) &&
+		(listLength(src) == 3)
+	);
+	left = -1;
+	listDestroy(list);
+	listDestroy(src);
+
+	// the first write to a clone fails at every allocation in turn, neither list loses a string
+	for (int budget = 0; budget < 12; budget++) {
+		list = listNewWithAllocator(4, &rationed);
+		listAdd(list, "a");
+		listAdd(list, "b");
+		listEnableMetadata(list);
+		listEnableIndex(list);
+		StringList* clone = listClone(list);
+		left = budget;
+		bool written = (listAdd(clone, "c") != NULL);
+		left = -1;
+		result = (
+			result &&
+			(listLength(clone) == (written ? 3 : 2)) &&
+			(strcmp(listGet(clone, 1), "b") == 0) &&
+			(listIndexOf(clone, "b") == 1) &&
+			(strcmp(listGet(list, 0), "a") == 0)
+		);
+		listDestroy(clone);
+		result = result && (strcmp(listGet(list, 1), "b") == 0);
+		listDestroy(list);
+	}
+
+	return result;
+}
+
+bool test_allocator() {
+	announce_test("list_allocator");
+
+	AllocationCount count = { 0, 0 };
+	ListAllocator allocator = { &counting_alloc, &counting_realloc, &counting_free, &count };
+
+	StringList* list = listNewWithAllocator(2, &allocator);
+	listAdd(list, "3");
+	listAdd(list, "1");
+	listAdd(list, "2");
+	listEnableIndex(list);
+	listEnableMetadata(list);
+	listSort(list, &strcmp);
+
+	StringList* clone = listClone(list);
+	listAdd(clone, "4"); // detaches the clone
+	StringList* sublist = listSublist(clone, 1, 3);
+	StringList* other = listNew();
+	listAdd(other, "2");
+	StringList* difference = listDifference(list, other);
+
+	char *taken = listTake(sublist, 0);
+	int allocations = count.allocations;
+
+	bool result = (
+		(allocations > 0) &&
+		(strcmp(taken, "2") == 0) &&
+		(listLength(difference) == 2) &&
+		(strcmp(listGet(clone, 3), "4") == 0)
+	);
+
+	counting_free(&count, taken); // taken buffers belong to the list's allocator
+	listDestroy(list);
+	listDestroy(clone);
+	listDestroy(sublist);
+	listDestroy(difference);
+	listDestroy(other);
+
+	result = result && (count.outstanding == 0);
+
+	return result;
+}
+
+bool test_stats() {
+	announce_test("list_stats");
+
+	StringList* list = listNewCapacity(2);
+	listAdd(list, "1");
+	listAdd(list, "22");
+	listAdd(list, "333"); // grows once
+	listInsert(list, 1, "4444");
+
+	ListStats stats;
+	listStats(list, &stats);
+
+	bool result = (
+		(stats.length == 4) &&
+		(stats.slot_bytes == (stats.capacity * sizeof(char*))) &&
+		(stats.element_bytes == (2 + 3 + 4 + 5)) &&
+		(stats.metadata_bytes == 0) &&
+		(stats.slack == ((double) (stats.capacity - 4) / stats.capacity)) &&
+		(stats.counters.expansions == 1) &&
+		!stats.shared
+	);
+
+	listEnableIndex(list);
+	listIndexOf(list, "333");
+	StringList* clone = listClone(list);
+	listStats(clone, &stats);
+
+	result = (
+		result &&
+		(stats.index_bytes > 0) &&
+		stats.shared
+	);
+
+#ifdef LIST_STATS
+	listStats(list, &stats);
+	result = (
+		result &&
+		(stats.counters.allocations >= 5) &&
+		(stats.counters.shifts >= 1)
+	);
+#else
+	result = result && (stats.counters.compares == 0) && (stats.counters.shifts == 0);
+#endif
+
+	StringList* arena = listNewArena(1, 64);
+	listAdd(arena, "x");
+	listStats(arena, &stats);
+	result = result && (stats.element_bytes >= 64) && !stats.overhead_known;
+
+	// a written clone of an inline list reads the source's cells, which it does not measure as heap buffers
+	StringList* cells = listNewInline(2);
+	listAdd(cells, "a");
+	listAdd(cells, "b");
+	StringList* written = listClone(cells);
+	listAdd(written, "c");
+	listStats(written, &stats);
+	result = result && (stats.length == 3) && stats.shared;
+
+	listDestroy(list);
+	listDestroy(clone);
+	listDestroy(arena);
+	listDestroy(cells);
+	listDestroy(written);
+
+	return result;
+}
+
+typedef struct {
+	int calls;
+	ListOperation last_operation;
+	const void *last_list;
+	int last_count;
+} trace_record;
+
+void record_trace(const ListOperation operation, const void *list, const int count, const uint64_t nanoseconds, void *context) {
+	trace_record *record = context;
+	record->calls++;
+	record->last_operation = operation;
+	record->last_list = list;
+	record->last_count = count;
+}
+
+bool test_trace() {
+	announce_test("list_trace");
+
+	ListHistogram *histogram = calloc(1, sizeof(ListHistogram));
+	listHistogramHook(LIST_OP_listAdd, NULL, 1, 100, histogram); // bucket 6, [64, 128)
+	listHistogramHook(LIST_OP_listAdd, NULL, 1, 100, histogram);
+	listHistogramHook(LIST_OP_listAdd, NULL, 1000, 5000, histogram); // bucket 12, [4096, 8192)
+
+	bool result = (
+		(strcmp(listOperationName(LIST_OP_listNew), "listNew") == 0) &&
+		(strcmp(listOperationName(LIST_OP_listIndexOf), "listIndexOf") == 0) &&
+		(histogram->buckets[LIST_OP_listAdd][6] == 2) &&
+		(histogram->size_calls[LIST_OP_listAdd][9] == 1) &&
+		(histogram->size_nanoseconds[LIST_OP_listAdd][0] == 200) &&
+		(listHistogramPercentile(histogram, LIST_OP_listAdd, 50) == 128) &&
+		(listHistogramPercentile(histogram, LIST_OP_listAdd, 100) == 8192) &&
+		(listHistogramPercentile(histogram, LIST_OP_listRemove, 50) == 0)
+	);
+
+	trace_record record = { 0 };
+	result = result && listAddTraceHook(&record_trace, &record) && listAddTraceHook(&listHistogramHook, histogram);
+
+	StringList* list = listNew();
+	listAdd(list, "1");
+	listAdd(list, "2");
+	listContains(list, "2"); // calls listIndexOf internally
+
+#ifdef LIST_TRACE
+	result = (
+		result &&
+		(record.calls == 4) &&
+		(record.last_operation == LIST_OP_listContains) &&
+		(record.last_list == list) &&
+		(record.last_count == 2) &&
+		(histogram->size_calls[LIST_OP_listIndexOf][1] == 0) &&
+		(histogram->size_calls[LIST_OP_listContains][1] == 1)
+	);
+#else
+	result = result && (record.calls == 0);
+#endif
+
+	listClearTraceHooks();
+	int calls = record.calls;
+	listDestroy(list);
+	result = result && (record.calls == calls); // no hooks left to report to
+
+	free(histogram);
+
+	return result;
+}
+
+#define CONCURRENT_TEST_WRITES 2000
+#define CONCURRENT_TEST_READERS 4
+
+typedef struct {
+	ConcurrentStringList *list;
+	atomic_bool *done;
+	bool consistent;
+} concurrent_reader;
+
+// the writer only appends the decimal numbers in order, so every version must be a prefix of them
+void *read_concurrently(void *arg) {
+	concurrent_reader *reader = arg;
+	char expected[16];
+	int last_length = 0;
+
+	while (!atomic_load(reader->done)) {
+		int slot;
+		const StringList *version = concurrentListReadBegin(reader->list, &slot);
+		int length = listLength(version);
+		reader->consistent = reader->consistent && (length >= last_length);
+		for (int i = 0; i < length; i += ((length / 8) + 1)) {
+			snprintf(expected, sizeof(expected), "%d", i);
+			reader->consistent = reader->consistent && (strcmp(listGet(version, i), expected) == 0);
+		}
+		concurrentListReadEnd(reader->list, slot);
+		last_length = length;
+
+		if (length > 0) {
+			snprintf(expected, sizeof(expected), "%d", (length - 1));
+			char *value = concurrentListGet(reader->list, (length - 1));
+			reader->consistent = reader->consistent && concurrentListContains(reader->list, expected) &&
+				(value != NULL) && (strcmp(value, expected) == 0);
+			free(value);
+		}
+
+		StringList *snapshot = concurrentListSnapshot(reader->list);
+		reader->consistent = reader->consistent && (listLength(snapshot) >= last_length);
+		listDestroy(snapshot);
+	}
+	return NULL;
+}
+
+bool sort_for_update(StringList *list, void *context) {
+	return (listSort(list, &strcmp) != NULL);
+}
+
+bool reject_update(StringList *list, void *context) {
+	listClear(list);
+	return false; // the cleared copy must not be published
+}
+
+bool test_concurrent_list() {
+	announce_test("concurrent_list");
+
+	ConcurrentStringList *list = concurrentListNew();
+	atomic_bool done = false;
+	concurrent_reader readers[CONCURRENT_TEST_READERS];
+	pthread_t threads[CONCURRENT_TEST_READERS];
+
+	for (int t = 0; t < CONCURRENT_TEST_READERS; t++) {
+		readers[t].list = list;
+		readers[t].done = &done;
+		readers[t].consistent = true;
+		pthread_create(&threads[t], NULL, &read_concurrently, &readers[t]);
+	}
+
+	bool result = true;
+	char value[16];
+	for (int i = 0; i < CONCURRENT_TEST_WRITES; i++) {
+		snprintf(value, sizeof(value), "%d", i);
+		result = result && concurrentListAdd(list, value);
+	}
+	atomic_store(&done, true);
+
+	for (int t = 0; t < CONCURRENT_TEST_READERS; t++) {
+		pthread_join(threads[t], NULL);
+		result = result && readers[t].consistent;
+	}
+
+	result = (
+		result &&
+		(concurrentListLength(list) == CONCURRENT_TEST_WRITES) &&
+		(concurrentListIndexOf(list, "1999") == 1999) &&
+		!concurrentListSet(list, CONCURRENT_TEST_WRITES, "x") && // out of range, nothing published
+		concurrentListInsert(list, 0, "first") &&
+		concurrentListRemoveElement(list, "0") &&
+		!concurrentListRemoveElement(list, "0") &&
+		concurrentListRemove(list, 0) &&
+		(concurrentListIndexOf(list, "1") == 0) &&
+		concurrentListClear(list) &&
+		(concurrentListLength(list) == 0) &&
+		(concurrentListGet(list, 0) == NULL)
+	);
+
+	StringList *more = listNew();
+	listAdd(more, "b");
+	listAdd(more, "a");
+	result = (
+		result &&
+		concurrentListAddAll(list, more) &&
+		concurrentListUpdate(list, &sort_for_update, NULL) &&
+		!concurrentListUpdate(list, &reject_update, NULL) &&
+		(concurrentListIndexOf(list, "a") == 0) &&
+		concurrentListContainsAll(list, more)
+	);
+
+	StringList *snapshot = concurrentListSnapshot(list);
+	concurrentListSet(list, 0, "changed");
+	result = result && (strcmp(listGet(snapshot, 0), "a") == 0);
+
+	listDestroy(snapshot);
+	listDestroy(more);
+	concurrentListDestroy(list);
+
+	return result;
+}
+
+#define APPEND_TEST_PRODUCERS 16
+#define APPEND_TEST_ADDS 5000
+
+typedef struct {
+	AppendStringList *list;
+	int producer;
+} append_producer;
+
+void *append_concurrently(void *arg) {
+	append_producer *producer = arg;
+	char value[32];
+	for (int i = 0; i < APPEND_TEST_ADDS; i++) {
+		snprintf(value, sizeof(value), "%d:%d", producer->producer, i);
+		appendListAdd(producer->list, value);
+	}
+	return NULL;
+}
+
+typedef struct {
+	AppendStringList *list;
+	atomic_bool *done;
+	bool consistent;
+} append_consumer;
+
+// every published element must be readable, and each producer's elements must appear in the order it added them
+void *consume_concurrently(void *arg) {
+	append_consumer *consumer = arg;
+	int next[APPEND_TEST_PRODUCERS] = { 0 };
+	int read = 0;
+
+	while (!atomic_load(consumer->done) || (read < appendListLength(consumer->list))) {
+		int length = appendListLength(consumer->list);
+		for (; read < length; read++) {
+			int producer, i;
+			char *value = appendListGet(consumer->list, read);
+			consumer->consistent = consumer->consistent && (value != NULL) && (sscanf(value, "%d:%d", &producer, &i) == 2) &&
+				(producer >= 0) && (producer < APPEND_TEST_PRODUCERS) && (i == next[producer]++);
+		}
+	}
+	return NULL;
+}
+
+bool test_append_list() {
+	announce_test("append_list");
+
+	AppendStringList *list = appendListNew();
+	atomic_bool done = false;
+	append_consumer consumer = { list, &done, true };
+	append_producer producers[APPEND_TEST_PRODUCERS];
+	pthread_t consumer_thread, threads[APPEND_TEST_PRODUCERS];
+
+	pthread_create(&consumer_thread, NULL, &consume_concurrently, &consumer);
+	for (int t = 0; t < APPEND_TEST_PRODUCERS; t++) {
+		producers[t].list = list;
+		producers[t].producer = t;
+		pthread_create(&threads[t], NULL, &append_concurrently, &producers[t]);
+	}
+	for (int t = 0; t < APPEND_TEST_PRODUCERS; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	atomic_store(&done, true);
+	pthread_join(consumer_thread, NULL);
+
+	StringList *copy = appendListToList(list);
+	bool result = (
+		consumer.consistent &&
+		(appendListLength(list) == (APPEND_TEST_PRODUCERS * APPEND_TEST_ADDS)) &&
+		(listLength(copy) == (APPEND_TEST_PRODUCERS * APPEND_TEST_ADDS)) &&
+		(strcmp(listGet(copy, 0), appendListGet(list, 0)) == 0)
+	);
+
+	listDestroy(copy);
+	appendListDestroy(list);
+
+	return result;
+}
+
+bool test_save_mapped() {
+	announce_test("list_save_mapped");
+
+	const char *path = "test_save_mapped.bin";
+	StringList* list = listNew();
+	listAdd(list, "alpha");
+	listAdd(list, "");
+	listAdd(list, "gamma");
+	listAdd(list, "alpha");
+
+	StringList* mapped = listSave(list, path) ? listOpenMapped(path) : NULL;
+	if (mapped == NULL) {
+		listDestroy(list);
+		remove(path);
+		return false;
+	}
+
+	ListStats stats;
+	listStats(mapped, &stats);
+	bool result = (
+		(listLength(mapped) == 4) &&
+		(strcmp(listGet(mapped, 2), "gamma") == 0) &&
+		(strcmp(listGet(mapped, 1), "") == 0) &&
+		(listIndexOf(mapped, "gamma") == 2) &&
+		(listLastIndexOf(mapped, "alpha") == 3) &&
+		!listContains(mapped, "beta") &&
+		listEquals(mapped, list) &&
+		(mapped->hashes != NULL) && // saved with the file, nothing to compute
+		(stats.element_bytes > 0) && !stats.overhead_known
+	);
+
+	listEnableIndex(mapped);
+	result = result && (listIndexOf(mapped, "alpha") == 0) && (mapped->mapping != NULL); // the index does not copy the pages
+
+	StringList* clone = listClone(mapped);
+
+	listAdd(clone, "delta"); // copies the clone to the heap, the mapping stays with 'mapped'
+	listSet(mapped, 0, "omega");
+	result = (
+		result &&
+		(clone->mapping == NULL) &&
+		(mapped->mapping == NULL) &&
+		(strcmp(listGet(clone, 0), "alpha") == 0) &&
+		(strcmp(listGet(clone, 4), "delta") == 0) &&
+		(listIndexOf(mapped, "omega") == 0) &&
+		(listIndexOf(mapped, "alpha") == 3)
+	);
+	listStats(mapped, &stats); // the strings it still reads from the file are not heap buffers
+	result = result && (stats.element_bytes == (6 + 1 + 6 + 6)) && stats.shared;
+
+	// a stored length that runs past its string, or past the file, rejects the whole file
+	uint32_t lengths[] = { 3, 1000 };
+	for (int i = 0; i < 2; i++) {
+		result = result && listSave(list, path);
+		FILE *file = fopen(path, "r+b");
+		fseek(file, (24 + (4 * (8 + 4))), SEEK_SET); // header, then offsets and hashes of the 4 elements
+		fwrite(&lengths[i], sizeof(uint32_t), 1, file);
+		fclose(file);
+		result = result && (listOpenMapped(path) == NULL);
+	}
+
+	StringList* empty = listNew();
+	StringList* reopened = listSave(empty, path) ? listOpenMapped(path) : NULL;
+	result = result && (reopened != NULL) && (listLength(reopened) == 0);
+
+	FILE *file = fopen(path, "wb");
+	fputs("not a list", file);
+	fclose(file);
+	result = result && (listOpenMapped(path) == NULL) && (listOpenMapped("no/such/file") == NULL);
+
+	remove(path);
+	listDestroy(list);
+	listDestroy(mapped);
+	listDestroy(clone);
+	listDestroy(empty);
+	if (reopened != NULL) {
+		listDestroy(reopened);
+	}
+
+	return result;
+}
+
+bool test_load_lines() {
+	announce_test("list_load_lines");
+
+	const char *path = "test_load_lines.txt";
+	FILE *file = fopen(path, "wb");
+	fputs("alpha\nbeta\r\n\ngamma", file);
+	fclose(file);
+
+	StringList* list = listLoadLines(path, '\n');
+	bool result = (
+		(list != NULL) &&
+		(listLength(list) == 4) &&
+		(strcmp(listGet(list, 0), "alpha") == 0) &&
+		(strcmp(listGet(list, 1), "beta") == 0) && // the CR of a CRLF ending is dropped
+		(strcmp(listGet(list, 2), "") == 0) &&
+		(strcmp(listGet(list, 3), "gamma") == 0) &&
+		(list->arena != NULL)
+	);
+	if (list != NULL) {
+		listAdd(list, "delta"); // loaded lists are ordinary arena lists
+		result = result && (listIndexOf(list, "delta") == 4);
+		listDestroy(list);
+	}
+
+	list = listLoadLines(path, ','); // no delimiter at all, one element
+	result = result && (list != NULL) && (listLength(list) == 1) && (strcmp(listGet(list, 0), "alpha\nbeta\r\n\ngamma") == 0);
+	if (list != NULL) {
+		listDestroy(list);
+	}
+	remove(path);
+	result = result && (listLoadLines(path, '\n') == NULL);
+
+	// a stream of unknown size is read in blocks, with lines cut across block boundaries
+	int lines = 300000;
+	size_t size = 0;
+	char *text = malloc(lines * 8);
+	for (int i = 0; i < lines; i++) {
+		size += sprintf(&text[size], "%d,", i);
+	}
+	file = fmemopen(text, size, "r");
+	list = listReadLines(file, ',');
+	fclose(file);
+
+	result = result && (list != NULL) && (listLength(list) == lines);
+	char expected[16];
+	for (int i = 0; result && (i < lines); i += 997) {
+		snprintf(expected, sizeof(expected), "%d", i);
+		result = (strcmp(listGet(list, i), expected) == 0);
+	}
+	if (list != NULL) {
+		listDestroy(list);
+	}
+	free(text);
+
+	file = tmpfile();
+	list = listReadLines(file, '\n');
+	fclose(file);
+	result = result && (list != NULL) && (listLength(list) == 0);
+	if (list != NULL) {
+		listDestroy(list);
+	}
+
+	return result;
+}
+
+bool test_join() {
+	announce_test("list_join");
+
+	StringList* list = listNew();
+	char *empty = listJoin(list, ", ");
+	listAdd(list, "a");
+	char *single = listJoin(list, ", ");
+	listAdd(list, "");
+	listAdd(list, "ccc");
+	char *joined = listJoin(list, ", ");
+	listEnableMetadata(list); // lengths come from the metadata instead
+	char *measured = listJoin(list, "");
+
+	bool result = (
+		(strcmp(empty, "") == 0) &&
+		(strcmp(single, "a") == 0) &&
+		(strcmp(joined, "a, , ccc") == 0) &&
+		(strcmp(measured, "accc") == 0)
+	);
+
+	// more than one buffer's worth, so listWrite has to flush along the way
+	StringList* large = listNew();
+	char value[16];
+	for (int i = 0; i < 100000; i++) {
+		snprintf(value, sizeof(value), "%d", i);
+		listAdd(large, value);
+	}
+	char *expected = listJoin(large, "\n");
+	size_t expected_length = strlen(expected);
+
+	FILE *file = tmpfile();
+	result = result && listWrite(large, file, "\n") && (ftell(file) == (long) expected_length);
+	char *written = malloc(expected_length + 1);
+	rewind(file);
+	written[fread(written, 1, expected_length, file)] = '\0';
+	fclose(file);
+	result = result && (strcmp(written, expected) == 0);
+
+	free(empty);
+	free(single);
+	free(joined);
+	free(measured);
+	free(expected);
+	free(written);
+	listDestroy(list);
+	listDestroy(large);
+
+	return result;
+}
+
 /*
 	TESTS BELOW THIS LINE HAVE NOT BEEN STAGED YET
 */
@@ -641,6 +2581,38 @@ int main() {
 		&test_remove_all,
 		&test_clear,
 		&test_contains_all,
+		&test_remove_range,
+		&test_new_arena,
+		&test_compact_arena,
+		&test_new_inline,
+		&test_enable_index,
+		&test_retain_all,
+		&test_set_operations,
+		&test_sort,
+		&test_sort_lexicographic,
+		&test_sort_parallel,
+		&test_sorted_insert,
+		&test_binary_search,
+		&test_enable_metadata,
+		&test_search_kernel,
+		&test_parallel_scans,
+		&test_queue,
+		&test_insert_front,
+		&test_tiered_list,
+		&test_owned,
+		&test_move_all,
+		&test_view,
+		&test_clone_shared,
+		&test_capacity_policy,
+		&test_allocator,
+		&test_failed_insert,
+		&test_stats,
+		&test_trace,
+		&test_concurrent_list,
+		&test_append_list,
+		&test_save_mapped,
+		&test_load_lines,
+		&test_join,
 	};
 
 	int test_count = sizeof(tests) / sizeof(bool (*)());